@@ -5,12 +5,7 @@
 // Copyright 2019 Andrei Dimitrief-Jianu
 
 #include "beamStratum.h"
-#include "crypto/sha256.c"
-
-#ifdef __APPLE__
-#include <libkern/OSByteOrder.h>
-#define htobe32(x) OSSwapHostToBigInt32(x)
-#endif
+#include "sha256Batch.h"
 
 namespace beamMiner 
 {
@@ -28,23 +23,41 @@ void beamStratum::syncSend(string data)
 	activateWrite();
 }
 
-// Got granted we can write to our connection, lets do so	
+// A TLS record carries at most 16KB, larger flushes are split into several records
+static const size_t maxRecordSize = 16384;
+
+// Got granted we can write to our connection, lets do so. All pending messages go into one 
+// buffer up to the size of a TLS record: the SSL stream encrypts only the first buffer of a 
+// sequence per write, so separate buffers would still end up as one record each.
 void beamStratum::activateWrite() 
 {
 	if (!activeWrite && writeRequests.size() > 0) 
 	{
 		activeWrite = true;
 
-		string json = writeRequests.front();
-		writeRequests.pop_front();
+		requestBuffer.clear();
+		uint32_t messages = 0;
+		while ((writeRequests.size() > 0) && ((messages == 0) || (requestBuffer.size() + writeRequests.front().size() <= maxRecordSize))) 
+		{
+			requestBuffer += writeRequests.front();
+			writeRequests.pop_front();
+			messages++;
+		}
+
+		uint32_t records = (requestBuffer.size() + maxRecordSize - 1) / maxRecordSize;
+		writeFlushes++;
+		writeMessages += messages;
+		writeRecords += records;
+		writeBytes += requestBuffer.size();
 
-		std::ostream os(&requestBuffer);
-		os << json;
-		if (!quiet && debug) cout << "Write to connection: " << json;
+		if (!quiet && debug) 
+		{
+			cout << "Write to connection (" << messages << " messages, " << requestBuffer.size() << " bytes, " << records << " TLS records): " << requestBuffer;
+		}
 
 		boost::asio::async_write(
 			*socket, 
-			requestBuffer, 
+			boost::asio::buffer(requestBuffer), 
 			boost::bind(&beamStratum::writeHandler,this, boost::asio::placeholders::error)); 		
 	}
 }
@@ -62,7 +75,8 @@ void beamStratum::writeHandler(const boost::system::error_code& err)
 
 void beamStratum::stopWorking()
 {
-	workId = -1;
+	job noWork;
+	publishJob(noWork);
 	io_service.reset();
 	socket->lowest_layer().close();
 }
@@ -136,7 +150,9 @@ void beamStratum::connect()
 			if (!quiet) cout << "Stratum error: " <<  _e.what() << endl;
 		}
 
-		workId = -1;
+		job noWork;
+		publishJob(noWork);
+		jobChanged();
 		io_service.reset();
 		socket->lowest_layer().close();
 
@@ -192,7 +208,7 @@ void beamStratum::handleHandshake(const boost::system::error_code& error)
 			*socket, 
 			responseBuffer, 
 			"\n",
-			boost::bind(&beamStratum::readStratum, this, boost::asio::placeholders::error));
+			boost::bind(&beamStratum::readStratum, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
 
 		if (!quiet) cout << "TLS Handshake O.K." << endl;
 		
@@ -209,136 +225,162 @@ void beamStratum::handleHandshake(const boost::system::error_code& error)
 	}
 }
 
-// Simple helper function that casts a hex string into byte array
-vector<uint8_t> parseHex (string input) 
-{
-	vector<uint8_t> result ;
-	result.reserve(input.length() / 2);
-	for (uint32_t i = 0; i < input.length(); i += 2)
-	{
-		uint32_t byte;
-		std::istringstream hex_byte(input.substr(i, 2));
-		hex_byte >> std::hex >> byte;
-		result.push_back(static_cast<unsigned char>(byte));
-	}
-
-	return result;
-}
-
 // Main stratum read function, will be called on every received data
-void beamStratum::readStratum(const boost::system::error_code& err) 
+void beamStratum::readStratum(const boost::system::error_code& err, size_t lineSize) 
 {
 	if (!err) 
 	{
-		// We just read something without problem.
-		std::istream is(&responseBuffer);
-		std::string response;
-		getline(is, response);
-
-		if (!quiet && debug) cout << "Incomming stratum: " << response << endl;
+		// We just read something without problem, the line is parsed where it was received
+		const char* line = boost::asio::buffer_cast<const char*>(responseBuffer.data());
+		size_t length = lineSize;
+		while ((length > 0) && ((line[length-1] == '\n') || (line[length-1] == '\r'))) length--;
 
-		// Parse the input to a property tree
-		pt::iptree jsonTree;
-		try 
+		if (!quiet && debug) 
 		{
-			istringstream jsonStream(response);
-			pt::read_json(jsonStream,jsonTree);
+			cout << "Incomming stratum: ";
+			cout.write(line, length);
+			cout << endl;
+		}
 
-			// This should be for any valid stratum
-			if (jsonTree.count("method") > 0) 
-			{	
-				string method = jsonTree.get<string>("method");
-			
-				// Result to a node request
-				if (method.compare("result") == 0) 
+		stratumMessage message;
+		bool valid = parseStratumMessage(line, length, message);
+
+		// This should be for any valid stratum
+		if (valid && message.method.present()) 
+		{	
+			// Result to a node request
+			if (message.method.equals("result")) 
+			{
+				int32_t code;
+				valid = message.code.toInt32(code);
+
+				// A login reply
+				if (valid && message.id.equals("login")) 
 				{
-					// A login reply
-					if (jsonTree.get<string>("id").compare("login") == 0) 
+					if (code >= 0) 
 					{
-						int32_t code = jsonTree.get<int32_t>("code");
-						if (code >= 0) 
-						{
-							if (!quiet) cout << "Login O.K. \n" << endl;
-							if (jsonTree.count("nonceprefix") > 0) 
-							{
-								string poolNonceStr = jsonTree.get<string>("nonceprefix");
-								poolNonce = parseHex(poolNonceStr);
-							} 
-							else 
-							{
-								poolNonce.clear();
-							}
-						} 
-						else 
+						if (!quiet) cout << "Login O.K. \n" << endl;
+						if (!message.nonceprefix.present() || !decodeHex(message.nonceprefix.data, message.nonceprefix.size, poolNonce)) 
 						{
-							if (!quiet) cout << "Error: Login at node not accepted." << endl;
-
-							stopWorking();
-						}	
+							poolNonce.clear();
+						}
 					} 
 					else 
 					{
-						// A share reply
-						int32_t code = jsonTree.get<int32_t>("code");
-						if (code == 1) 
+						if (!quiet) cout << "Error: Login at node not accepted." << endl;
+
+						stopWorking();
+					}	
+				} 
+				else if (valid) 
+				{
+					// A share reply
+					if (code == 1) 
+					{
+						if (!quiet) 
 						{
-							if (!quiet) cout << "Solution for work id " << jsonTree.get<string>("id") << " accepted" << endl;
-							sharesAcc++;
-						} 
-						else 
+							cout << "Solution for work id ";
+							cout.write(message.id.data, message.id.size);
+							cout << " accepted" << endl;
+						}
+						sharesAcc++;
+					} 
+					else 
+					{
+						if (!quiet) 
 						{
-							if (!quiet) cout << "Warning: Solution for work id " << jsonTree.get<string>("id") << " not accepted" << endl;
-							sharesRej++;
+							cout << "Warning: Solution for work id ";
+							cout.write(message.id.data, message.id.size);
+							cout << " not accepted" << endl;
 						}
+						sharesRej++;
 					}
 				}
+			}
 
-				// A new job decription;
-				if (method.compare("job") == 0) 
+			// A new job decription;
+			if (message.method.equals("job")) 
+			{
+				uint64_t id;
+				uint64_t stratDiff;
+				valid = (message.input.size == 64) && isHex(message.input.data, message.input.size) && message.id.toUint64(id) && message.difficulty.toUint64(stratDiff) && (stratDiff <= UINT32_MAX);
+
+				if (valid) 
 				{
-					updateMutex.lock();
-					// Get new work load
-					string work = jsonTree.get<string>("input");
-					serverWork = parseHex(work);
+					job newJob;
+
+					// Get new work load, the 32 byte header
+					std::vector<uint8_t> input;
+					decodeHex(message.input.data, message.input.size, input);
+					memcpy(newJob.input, input.data(), sizeof(newJob.input));
 
 					// Get jobId of new job
-					workId = jsonTree.get<uint64_t>("id");	
+					newJob.workId = id;	
 					
 					// Get the target difficulty
-					uint32_t stratDiff = jsonTree.get<uint32_t>("difficulty");
-					powDiff = beam::Difficulty(stratDiff);
-					updateMutex.unlock();	
+					newJob.powDiff = beam::Difficulty((uint32_t) stratDiff);
+					newJob.target = shareTarget(newJob.powDiff);
 
-					if (!quiet) cout << "New work received id:difficulty " << workId << " : " << std::fixed << std::setprecision(0) << powDiff.ToFloat() << endl;
+					// The pool nonce of the login goes with the job, need some range left for miner
+					newJob.poolNonceBytes = min<uint32_t>(poolNonce.size(), sizeof(newJob.poolNonce));
+					memcpy(newJob.poolNonce, poolNonce.data(), newJob.poolNonceBytes);
+
+					publishJob(newJob);
+					jobChanged();
+
+					if (!quiet) cout << "New work received id:difficulty " << newJob.workId << " : " << std::fixed << std::setprecision(0) << newJob.powDiff.ToFloat() << endl;
 				}
+			}
 
-				// Cancel a running job
-				if (method.compare("cancel") == 0) 
+			// Cancel a running job
+			if (message.method.equals("cancel")) 
+			{
+				// Get jobId of canceled job
+				uint64_t id;
+				valid = message.id.toUint64(id);
+
+				if (valid) 
 				{
-					updateMutex.lock();
-					// Get jobId of canceled job
-					uint64_t id =  jsonTree.get<uint64_t>("id");
-					// Set it to an unlikely value;
-					if (id == workId) workId = -1;
-					updateMutex.unlock();
+					// Only the stratum thread publishes jobs, so the current one can not change meanwhile
+					bool canceled = (id == currentJob.load().workId);
+					if (canceled) 
+					{
+						job noWork;
+						publishJob(noWork);
+						jobChanged();
+					}
 				}
-				t_current = time(NULL);
+			}
+			t_current = time(NULL);
 
-				if (!quiet) cout << "Solutions (accepted/rejected): " << sharesAcc << "/" << sharesRej << " Uptime: " << (int)(t_current-t_start) << " sec" << endl; 
+			if (!quiet) 
+			{
+				cout << "Solutions (accepted/rejected): " << sharesAcc << "/" << sharesRej << " Uptime: " << (int)(t_current-t_start) << " sec";
+				if (submits.droppedCount() > 0) cout << " Dropped: " << submits.droppedCount();
+				if (debug) cout << " Submit queue peak: " << submits.peakDepth() << "/" << submits.getCapacity();
+				if (debug && (writeFlushes > 0)) 
+				{
+					cout << " Writes: " << writeMessages << " messages in " << writeRecords << " TLS records, " << writeBytes / writeFlushes << " bytes per flush";
+				}
+				cout << endl; 
 			}
+		}
 
-		} 
-		catch(const pt::ptree_error &e) 
+		if (!valid && !quiet) 
 		{
-			if (!quiet) cout << "Json parse error: " << e.what() << endl; 
+			cout << "Json parse error: ";
+			cout.write(line, length);
+			cout << endl;
 		}
 
+		responseBuffer.consume(lineSize);
+
 		// Prepare to continue reading
 		boost::asio::async_read_until(
 			*socket, 
 			responseBuffer, 
 			"\n",
-        	boost::bind(&beamStratum::readStratum, this, boost::asio::placeholders::error));
+        	boost::bind(&beamStratum::readStratum, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
 	}
 }
 
@@ -355,7 +397,7 @@ bool beamStratum::hasConnection()
 // Checking if we have valid work, else the GPUs will pause
 bool beamStratum::hasWork() 
 {
-	return (workId >= 0);
+	return (currentJob.load().workId >= 0);
 }
 
 // function the clHost class uses to fetch new work
@@ -364,170 +406,143 @@ void beamStratum::getWork(WorkDescription& wd, uint8_t* dataOut)
 	// nonce is atomic, so every time we call this will get a nonce increased by one
 	uint64_t cliNonce = nonce.fetch_add(1);
 
-	uint8_t* noncePoint = (uint8_t*) &wd.nonce;
+	// Never blocks, a job published meanwhile only makes this batch stale
+	job current = currentJob.load();
 
-	uint32_t poolNonceBytes = min<uint32_t>(poolNonce.size(), 6); 	// Need some range left for miner
-	wd.nonce = (cliNonce << 8*poolNonceBytes);
+	uint8_t* noncePoint = (uint8_t*) &wd.nonce;
+	wd.nonce = (cliNonce << 8*current.poolNonceBytes);
 
-	for (uint32_t i=0; i<poolNonceBytes; i++) 
+	for (uint32_t i=0; i<current.poolNonceBytes; i++) 
 	{
 		// Prefix pool nonce
-		noncePoint[i] = poolNonce[i];
+		noncePoint[i] = current.poolNonce[i];
 	}
-	
-	updateMutex.lock();
 
-	wd.workId = workId;
-	wd.powDiff = powDiff;
-	memcpy(dataOut, serverWork.data(), 32);
-
-	updateMutex.unlock();
+	wd.workId = current.workId;
+	wd.powDiff = current.powDiff;
+	wd.target = current.target;
+	wd.epoch = current.epoch;
+	memcpy(dataOut, current.input, 32);
 }
 
-void CompressArray(
-	const unsigned char* in, size_t in_len,
-    unsigned char* out, size_t out_len,
-    size_t bit_len, size_t byte_pad) 
+// The epoch is raised before the job is stored, a reader in between still gets the old job
+// with the old epoch and so a stale batch. Only called from the stratum thread.
+void beamStratum::publishJob(job& newJob) 
 {
-	assert(bit_len >= 8);
-	assert(8*sizeof(uint32_t) >= bit_len);
-
-	size_t in_width { (bit_len+7)/8 + byte_pad };
-	assert(out_len == (bit_len*in_len/in_width + 7)/8);
-
-	uint32_t bit_len_mask { ((uint32_t)1 << bit_len) - 1 };
-
-	// The acc_bits least-significant bits of acc_value represent a bit sequence
-	// in big-endian order.
-	size_t acc_bits = 0;
-	uint32_t acc_value = 0;
-
-	size_t j = 0;
-	for (size_t i = 0; i < out_len; i++) 
-	{
-		// When we have fewer than 8 bits left in the accumulator, read the next
-		// input element.
-		if (acc_bits < 8) 
-		{
-			if (j < in_len) 
-			{
-				acc_value = acc_value << bit_len;
-				for (size_t x = byte_pad; x < in_width; x++) 
-				{
-					acc_value = acc_value | (
-					(
-					// Apply bit_len_mask across byte boundaries
-					in[j + x] & ((bit_len_mask >> (8 * (in_width - x - 1))) & 0xFF)
-					) << (8 * (in_width - x - 1))); // Big-endian
-				}
-				j += in_width;
-				acc_bits += bit_len;
-			}
-			else 
-			{
-				acc_value <<= 8 - acc_bits;
-				acc_bits += 8 - acc_bits;;
-			}
-		}
-
-		acc_bits -= 8;
-		out[i] = (acc_value >> acc_bits) & 0xFF;
-	}
+	newJob.epoch = jobEpoch + 1;
+	jobEpoch = newJob.epoch;
+	currentJob.store(newJob);
 }
 
-#ifdef WIN32
-
-inline uint32_t htobe32(uint32_t x)
+// Batches of an older epoch are stale, their solutions would be rejected
+bool beamStratum::isCurrent(const WorkDescription& wd) 
 {
-    return (((x & 0xff000000U) >> 24) | ((x & 0x00ff0000U) >> 8) |
-        ((x & 0x0000ff00U) << 8) | ((x & 0x000000ffU) << 24));
+	return (wd.epoch == jobEpoch);
 }
 
-
-#endif // WIN32
-
-// Big-endian so that lexicographic array comparison is equivalent to integer comparison
-void EhIndexToArray(const uint32_t i, unsigned char* array) 
+// Listeners are registered before startWorking and called from the stratum thread
+void beamStratum::addJobListener(std::function<void()> listener) 
 {
-	static_assert(sizeof(uint32_t) == 4, "");
-	uint32_t bei = htobe32(i);
-	memcpy(array, &bei, sizeof(uint32_t));
+	jobListeners.push_back(listener);
 }
 
+void beamStratum::jobChanged() 
+{
+	for (std::function<void()>& listener : jobListeners) listener();
+}
 
-// Helper function that compresses the solution from 32 unsigned integers (128 bytes) to 104 bytes
-std::vector<unsigned char> GetMinimalFromIndices(std::vector<uint32_t> indices, size_t cBitLen) 
+void beamStratum::testSolutions(
+	const shareTarget& target, 
+	const vector< vector<uint32_t> >& solutions, 
+	vector<uint8_t>& compressed, 
+	vector<uint8_t>& reached) 
 {
-	assert(((cBitLen+1)+7)/8 <= sizeof(uint32_t));
-	size_t lenIndices { indices.size()*sizeof(uint32_t) };
-	size_t minLen { (cBitLen+1)*lenIndices/(8*sizeof(uint32_t)) };
-	size_t bytePad { sizeof(uint32_t) - ((cBitLen+1)+7)/8 };
-	std::vector<unsigned char> array(lenIndices);
-	for (size_t i = 0; i < indices.size(); i++) 
+	// get the compressed representation of the solutions and hash them together
+	const uint32_t size = beamSolutionCodec::packedSize;
+	compressed.resize(size * solutions.size());
+	vector<const uint8_t*> messages(solutions.size());
+	for (size_t i = 0; i < solutions.size(); i++) 
 	{
-		EhIndexToArray(indices[i], array.data()+(i*sizeof(uint32_t)));
+		beamSolutionCodec::pack(solutions[i].data(), &compressed[size * i]);
+		messages[i] = &compressed[size * i];
 	}
-	std::vector<unsigned char> ret(minLen);
-	CompressArray(array.data(), lenIndices, ret.data(), minLen, cBitLen+1, bytePad);
-	
-	return ret;
-}
 
-bool beamStratum::testSolution(
-	const beam::Difficulty& diff, 
-	const vector<uint32_t>& indices, 
-	vector<uint8_t>& compressed) 
-{
-	// get the compressed representation of the solution and check against target
-	compressed = GetMinimalFromIndices(indices,25);
+	reached.assign(solutions.size(), false);
+	if (solutions.size() == 0) return;
 
-	beam::uintBig_t<32> hv;
-	Sha256_Onestep(compressed.data(), compressed.size(), hv.m_pData);
+	vector<uint8_t> hashes(32 * solutions.size());
+	sha256Batch(messages.data(), size, solutions.size(), hashes.data());
 
-	return diff.IsTargetReached(hv);
+	for (size_t i = 0; i < solutions.size(); i++) reached[i] = target.isReachedBy(&hashes[32*i]);
 }
 
-void beamStratum::submitSolution(
-	int64_t wId, 
-	uint64_t nonceIn, 
-	const std::vector<uint8_t>& compressed) 
+// Runs on the stratum thread, the caller starts the write
+void beamStratum::submitSolution(const submitRequest& request) 
 {
 	// The solutions target is low enough, lets submit it
-	vector<uint8_t> nonceBytes;
-			
-	nonceBytes.assign(8,0);
-	*((uint64_t*) nonceBytes.data()) = nonceIn;
+	int64_t wId = request.workId;
+
+	// The nonce goes out in memory byte order
+	char nonceHex[16];
+	encodeHex((const uint8_t*) &request.nonce, 8, nonceHex);
 
-	stringstream nonceHex;
-	for (int c=0; c<nonceBytes.size(); c++) 
+	char solutionHex[2 * submitRequest::maxSolutionSize];
+	encodeHex(request.solution, request.solutionSize, solutionHex);
+			
+	// Line the stratum msg up
+	string json;
+	json.reserve(128 + sizeof(solutionHex));
+	json += "{\"method\" : \"solution\", \"id\": \"";
+	json += to_string(wId);
+	json += "\", \"nonce\": \"";
+	json.append(nonceHex, sizeof(nonceHex));
+	json += "\", \"output\": \"";
+	json.append(solutionHex, 2 * request.solutionSize);
+	json += "\", \"jsonrpc\":\"2.0\" } \n";
+
+	writeRequests.push_back(std::move(json));	
+
+	if (!quiet) 
 	{
-		nonceHex << std::setfill('0') << std::setw(2) << std::hex << (unsigned) nonceBytes[c];
+		cout << "Submitting solution to job " << wId << " with nonce ";
+		cout.write(nonceHex, sizeof(nonceHex));
+		cout << endl;
 	}
+}
+
+// Will be called by clHost class for check & submit of all solutions of one batch
+void beamStratum::handleSolutions(const WorkDescription& wd, vector< vector<uint32_t> > &solutions) 
+{
+	bool queued = false;
+	vector<uint8_t> compressed;
+	vector<uint8_t> reached;
+	testSolutions(wd.target, solutions, compressed, reached);
 
-	stringstream solutionHex;
-	for (int c=0; c<compressed.size(); c++) 
+	for (size_t i = 0; i < solutions.size(); i++) 
 	{
-		solutionHex << std::setfill('0') << std::setw(2) << std::hex << (unsigned) compressed[c];
-	}	
-			
-	// Line the stratum msg up
-	std::stringstream json;
-	json << "{\"method\" : \"solution\", \"id\": \"" << wId << "\", \"nonce\": \"" << nonceHex.str() 
-			<< "\", \"output\": \"" << solutionHex.str() << "\", \"jsonrpc\":\"2.0\" } \n";
+		if (!reached[i]) continue;
 
-	queueDataSend(json.str());	
+		if (!submits.push(wd.workId, wd.nonce, &compressed[beamSolutionCodec::packedSize * i], beamSolutionCodec::packedSize)) 
+		{
+			if (!quiet) cout << "Submit queue full, dropping solution to job " << wd.workId << endl;
+			continue;
+		}
+		queued = true;
+	}
 
-	if (!quiet) cout << "Submitting solution to job " << wId << " with nonce " <<  nonceHex.str() << endl;
+	if (queued && !drainPending.exchange(true)) io_service.post(boost::bind(&beamStratum::drainSubmits, this));
 }
 
-// Will be called by clHost class for check & submit
-void beamStratum::handleSolution(const WorkDescription& wd, vector<uint32_t> &indices) 
+// Submits everything queued so far, solutions pushed after the flag was cleared post a new drain
+void beamStratum::drainSubmits() 
 {
-	std::vector<uint8_t> compressed;
-	if (testSolution(wd.powDiff, indices, compressed))
-	{
-		std::thread (&beamStratum::submitSolution,this,wd.workId,wd.nonce,std::move(compressed)).detach();
-	}
+	drainPending = false;
+
+	submitRequest request;
+	while (submits.pop(request)) submitSolution(request);
+
+	// All solutions of the drain leave in one write
+	activateWrite();
 }
 
 beamStratum::beamStratum(
@@ -552,9 +567,6 @@ beamStratum::beamStratum(
 	debug = debugIn;
 	quiet = quietIn;
 
-	// Assign the work field and nonce
-	serverWork.assign(32,(uint8_t) 0);
-
 	random_device rd;
 	default_random_engine generator(rd());
 	uniform_int_distribution<uint64_t> distribution(0,0xFFFFFFFFFFFFFFFF);
@@ -562,8 +574,9 @@ beamStratum::beamStratum(
 	// We pick a random start nonce
 	nonce = distribution(generator);
 
-	// No work in the beginning
-	workId = -1;
+	// No work in the beginning, the default job has none
+	jobEpoch = 0;
+	drainPending = false;
 }
 
 } // End namespace beamMiner
@@ -12,6 +12,7 @@
 #include <vector>
 #include <deque>
 #include <random>
+#include <functional>
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/asio.hpp>
@@ -19,16 +20,19 @@
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
-
 #include "core/difficulty.h"
 #include "core/uintBig.h"
 
+#include "submitQueue.h"
+#include "stratumJson.h"
+#include "hexCodec.h"
+#include "shareTarget.h"
+#include "solutionCodec.h"
+#include "seqlock.h"
+
 using namespace std;
 using namespace boost::asio;
 using boost::asio::ip::tcp;
-namespace pt = boost::property_tree;
 
 namespace beamMiner {
 
@@ -42,7 +46,7 @@ class beamStratum {
 	boost::asio::io_service io_service;
 	boost::scoped_ptr< boost::asio::ssl::stream<tcp::socket> > socket;
 	tcp::resolver res;
-	boost::asio::streambuf requestBuffer;
+	string requestBuffer;
 	boost::asio::streambuf responseBuffer;
 	boost::asio::ssl::context context;
 
@@ -57,11 +61,24 @@ class beamStratum {
 	bool connected = false;
 	int32_t connectAttempts = 2;
 
-	// Storage for received work
-	int64_t workId;
-	std::vector<uint8_t> serverWork;
+	// Storage for received work. The stratum thread publishes every change as a whole job,
+	// the miner threads copy it out of the seqlock without blocking.
+	struct job 
+	{
+		int64_t workId = -1;		// -1 if there is no work
+		uint64_t epoch = 0;
+		uint8_t input[32] = {0};
+		beam::Difficulty powDiff;
+		shareTarget target;
+		uint8_t poolNonce[6] = {0};
+		uint32_t poolNonceBytes = 0;
+	};
+	seqlock<job> currentJob;
+	std::atomic<uint64_t> jobEpoch;
+	void publishJob(job&);
+	std::vector< std::function<void()> > jobListeners;
+	void jobChanged();
 	std::atomic<uint64_t> nonce;
-	beam::Difficulty powDiff;
 	std::vector<uint8_t> poolNonce;
 	// Stat
 	uint64_t sharesAcc = 0;
@@ -76,9 +93,14 @@ class beamStratum {
 	void writeHandler(const boost::system::error_code&);	
 	std::deque<string> writeRequests;
 
+	// Write statistics, each flush sends all pending messages at once
+	uint64_t writeFlushes = 0;
+	uint64_t writeMessages = 0;
+	uint64_t writeRecords = 0;
+	uint64_t writeBytes = 0;
+
 	// Stratum receiving subsystem
-	void readStratum(const boost::system::error_code&);
-	boost::mutex updateMutex;
+	void readStratum(const boost::system::error_code&, size_t);
 
 	// Connection handling
 	void connect();
@@ -87,8 +109,14 @@ class beamStratum {
 	bool verifyCertificate(bool,boost::asio::ssl::verify_context& );
 
 	// Solution Check & Submit
-	static bool testSolution(const beam::Difficulty&, const std::vector<uint32_t>&, std::vector<uint8_t>&);
-	void submitSolution(int64_t, uint64_t, const std::vector<uint8_t>&);
+	static void testSolutions(const shareTarget&, const std::vector< std::vector<uint32_t> >&, std::vector<uint8_t>&, std::vector<uint8_t>&);
+	void submitSolution(const submitRequest&);
+
+	// Solutions travel from the miner threads to the stratum thread through this queue,
+	// a drain is posted to the io_service only if none is pending yet
+	submitQueue submits;
+	std::atomic<bool> drainPending;
+	void drainSubmits();
 
 	public:
 	beamStratum(string, string, string, bool, bool);
@@ -100,6 +128,8 @@ class beamStratum {
 		int64_t workId;
 		uint64_t nonce;
 		beam::Difficulty powDiff;
+		shareTarget target;
+		uint64_t epoch;
 	};
 
 	bool isConnecting();
@@ -107,7 +137,11 @@ class beamStratum {
 	bool hasWork();
 	void getWork(WorkDescription&, uint8_t*);
 
-	void handleSolution(const WorkDescription&, std::vector<uint32_t>&);
+	// The epoch changes with every new job, cancel or lost connection
+	bool isCurrent(const WorkDescription&);
+	void addJobListener(std::function<void()>);
+
+	void handleSolutions(const WorkDescription&, std::vector< std::vector<uint32_t> >&);
 	
 };
 
@@ -0,0 +1,98 @@
+// BEAM OpenCL Miner
+// Blake2b of the Equihash elements on the host
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "blake2b.h"
+#include "cpuFeatures.h"
+
+#include <cstddef>
+
+namespace beamMiner 
+{
+
+static inline uint64_t ror64(uint64_t x, uint32_t n) 
+{
+	return (x >> n) | (x << (64 - n));
+}
+
+#define G(a, b, c, d, x, y) \
+	a = a + b + x; d = ror64(d ^ a, 32); \
+	c = c + d;     b = ror64(b ^ c, 24); \
+	a = a + b + y; d = ror64(d ^ a, 16); \
+	c = c + d;     b = ror64(b ^ c, 63);
+
+void beamHashesScalar(const uint64_t* header, uint64_t nonce, uint32_t first, uint32_t count, uint64_t* out) 
+{
+	uint64_t state[8];
+	blakeInitState(state);
+
+	uint64_t m[16] = {header[0], header[1], header[2], header[3], nonce};
+
+	for (uint32_t n = 0; n < count; n++) 
+	{
+		m[5] = first + n;
+
+		uint64_t v[16];
+		for (int i = 0; i < 8; i++) 
+		{
+			v[i] = state[i];
+			v[i+8] = blakeIV[i];
+		}
+		v[12] ^= blakeMessageLength;
+		v[14] = ~v[14];
+
+		for (int r = 0; r < 12; r++) 
+		{
+			const uint8_t* s = blakeSigma[r];
+			G(v[0], v[4], v[8],  v[12], m[s[0]],  m[s[1]]);
+			G(v[1], v[5], v[9],  v[13], m[s[2]],  m[s[3]]);
+			G(v[2], v[6], v[10], v[14], m[s[4]],  m[s[5]]);
+			G(v[3], v[7], v[11], v[15], m[s[6]],  m[s[7]]);
+			G(v[0], v[5], v[10], v[15], m[s[8]],  m[s[9]]);
+			G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+			G(v[2], v[7], v[8],  v[13], m[s[12]], m[s[13]]);
+			G(v[3], v[4], v[9],  v[14], m[s[14]], m[s[15]]);
+		}
+
+		for (int i = 0; i < 8; i++) out[8*n + i] = state[i] ^ v[i] ^ v[i+8];
+	}
+}
+
+typedef bool (*vectorHashes)(const uint64_t*, uint64_t, uint32_t, uint32_t, uint64_t*);
+
+// Widest implementation the CPU runs and the compiler built, NULL for the scalar code
+static vectorHashes selectHashes(uint32_t& lanes) 
+{
+	static const uint64_t header[4] = {0};
+	uint64_t test[8*8];
+
+	const cpuFeatures& features = hostCpuFeatures();
+	if (features.avx512 && beamHashesAvx512(header, 0, 0, 8, test)) 
+	{
+		lanes = 8;
+		return beamHashesAvx512;
+	}
+	if (features.avx2 && beamHashesAvx2(header, 0, 0, 4, test)) 
+	{
+		lanes = 4;
+		return beamHashesAvx2;
+	}
+
+	lanes = 1;
+	return NULL;
+}
+
+void beamHashes(const uint64_t* header, uint64_t nonce, uint32_t first, uint32_t count, uint64_t* out) 
+{
+	static uint32_t lanes;
+	static const vectorHashes hashes = selectHashes(lanes);
+
+	uint32_t vectorCount = (hashes != NULL) ? (count / lanes) * lanes : 0;
+	if (vectorCount > 0) hashes(header, nonce, first, vectorCount, out);
+
+	if (vectorCount < count) beamHashesScalar(header, nonce, first + vectorCount, count - vectorCount, out + 8*vectorCount);
+}
+
+}
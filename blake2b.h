@@ -0,0 +1,65 @@
+// BEAM OpenCL Miner
+// Blake2b of the Equihash elements on the host
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_blake2b_H 
+#define beamMiner_blake2b_H 
+
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Every hash covers the 32 byte block header, the 8 byte nonce and a 4 byte index, 
+// like round0 of the kernels. It uses the Beam-PoW personalization and yields 57 bytes.
+static const uint32_t blakeMessageLength = 44;
+static const uint32_t blakeOutputLength = 57;
+
+static const uint64_t blakeIV[8] = 
+{
+	0x6a09e667f3bcc908, 0xbb67ae8584caa73b,
+	0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+	0x510e527fade682d1, 0x9b05688c2b3e6c1f,
+	0x1f83d9abfb41bd6b, 0x5be0cd19137e2179
+};
+
+static const uint8_t blakeSigma[12][16] = 
+{
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+// Chaining value after the parameter block: output length, "Beam-PoW", n = 150 and k = 5
+inline void blakeInitState(uint64_t state[8]) 
+{
+	for (int i = 0; i < 8; i++) state[i] = blakeIV[i];
+
+	state[0] ^= 0x01010000 | blakeOutputLength;
+	state[6] ^= 0x576F502D6D616542;
+	state[7] ^= ((uint64_t) 5 << 32) | 150;
+}
+
+// Hashes the indices first to first+count-1, out receives the 8 state words of each
+void beamHashes(const uint64_t* header, uint64_t nonce, uint32_t first, uint32_t count, uint64_t* out);
+
+// The implementations behind beamHashes. The vector versions hash 4 or 8 indices at once 
+// and return false if the compiler did not build them for the instruction set.
+void beamHashesScalar(const uint64_t*, uint64_t, uint32_t, uint32_t, uint64_t*);
+bool beamHashesAvx2(const uint64_t*, uint64_t, uint32_t, uint32_t, uint64_t*);
+bool beamHashesAvx512(const uint64_t*, uint64_t, uint32_t, uint32_t, uint64_t*);
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+// BEAM OpenCL Miner
+// Blake2b of the Equihash elements, four indices per AVX2 register
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+// This file is built with AVX2 enabled, beamHashes only calls it on CPUs that have it
+
+#include "blake2b.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace beamMiner 
+{
+
+#ifdef __AVX2__
+static inline __m256i ror32(__m256i x) 
+{
+	return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline __m256i ror24(__m256i x) 
+{
+	static const __m256i mask = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+	return _mm256_shuffle_epi8(x, mask);
+}
+
+static inline __m256i ror16(__m256i x) 
+{
+	static const __m256i mask = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+	return _mm256_shuffle_epi8(x, mask);
+}
+
+static inline __m256i ror63(__m256i x) 
+{
+	return _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+}
+
+#define G(a, b, c, d, x, y) \
+	a = _mm256_add_epi64(_mm256_add_epi64(a, b), x); d = ror32(_mm256_xor_si256(d, a)); \
+	c = _mm256_add_epi64(c, d);                      b = ror24(_mm256_xor_si256(b, c)); \
+	a = _mm256_add_epi64(_mm256_add_epi64(a, b), y); d = ror16(_mm256_xor_si256(d, a)); \
+	c = _mm256_add_epi64(c, d);                      b = ror63(_mm256_xor_si256(b, c));
+#endif
+
+bool beamHashesAvx2(const uint64_t* header, uint64_t nonce, uint32_t first, uint32_t count, uint64_t* out) 
+{
+#ifdef __AVX2__
+	uint64_t state[8];
+	blakeInitState(state);
+
+	__m256i m[16];
+	for (int i = 0; i < 16; i++) m[i] = _mm256_setzero_si256();
+	for (int i = 0; i < 4; i++) m[i] = _mm256_set1_epi64x(header[i]);
+	m[4] = _mm256_set1_epi64x(nonce);
+
+	for (uint32_t n = 0; n < count; n += 4) 
+	{
+		m[5] = _mm256_setr_epi64x(first + n, first + n + 1, first + n + 2, first + n + 3);
+
+		__m256i v[16];
+		for (int i = 0; i < 8; i++) 
+		{
+			v[i] = _mm256_set1_epi64x(state[i]);
+			v[i+8] = _mm256_set1_epi64x(blakeIV[i]);
+		}
+		v[12] = _mm256_set1_epi64x(blakeIV[4] ^ blakeMessageLength);
+		v[14] = _mm256_set1_epi64x(~blakeIV[6]);
+
+		for (int r = 0; r < 12; r++) 
+		{
+			const uint8_t* s = blakeSigma[r];
+			G(v[0], v[4], v[8],  v[12], m[s[0]],  m[s[1]]);
+			G(v[1], v[5], v[9],  v[13], m[s[2]],  m[s[3]]);
+			G(v[2], v[6], v[10], v[14], m[s[4]],  m[s[5]]);
+			G(v[3], v[7], v[11], v[15], m[s[6]],  m[s[7]]);
+			G(v[0], v[5], v[10], v[15], m[s[8]],  m[s[9]]);
+			G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+			G(v[2], v[7], v[8],  v[13], m[s[12]], m[s[13]]);
+			G(v[3], v[4], v[9],  v[14], m[s[14]], m[s[15]]);
+		}
+
+		// Transpose the lanes back into one state per index
+		alignas(32) uint64_t lanes[8][4];
+		for (int i = 0; i < 8; i++) 
+		{
+			__m256i h = _mm256_xor_si256(_mm256_set1_epi64x(state[i]), _mm256_xor_si256(v[i], v[i+8]));
+			_mm256_store_si256((__m256i*) lanes[i], h);
+		}
+
+		for (int l = 0; l < 4; l++) 
+		{
+			for (int i = 0; i < 8; i++) out[8*(n + l) + i] = lanes[i][l];
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+}
@@ -0,0 +1,85 @@
+// BEAM OpenCL Miner
+// Blake2b of the Equihash elements, eight indices per AVX-512 register
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+// This file is built with AVX-512 enabled, beamHashes only calls it on CPUs that have it
+
+#include "blake2b.h"
+
+#ifdef __AVX512F__
+#include <immintrin.h>
+#endif
+
+namespace beamMiner 
+{
+
+#ifdef __AVX512F__
+// The masked form with all lanes set is the same vprorq, unlike _mm512_ror_epi64 it needs no
+// undefined source register that GCC warns about
+#define ROR(x, n) _mm512_maskz_ror_epi64(0xFF, x, n)
+
+#define G(a, b, c, d, x, y) \
+	a = _mm512_add_epi64(_mm512_add_epi64(a, b), x); d = ROR(_mm512_xor_si512(d, a), 32); \
+	c = _mm512_add_epi64(c, d);                      b = ROR(_mm512_xor_si512(b, c), 24); \
+	a = _mm512_add_epi64(_mm512_add_epi64(a, b), y); d = ROR(_mm512_xor_si512(d, a), 16); \
+	c = _mm512_add_epi64(c, d);                      b = ROR(_mm512_xor_si512(b, c), 63);
+#endif
+
+bool beamHashesAvx512(const uint64_t* header, uint64_t nonce, uint32_t first, uint32_t count, uint64_t* out) 
+{
+#ifdef __AVX512F__
+	uint64_t state[8];
+	blakeInitState(state);
+
+	__m512i m[16];
+	for (int i = 0; i < 16; i++) m[i] = _mm512_setzero_si512();
+	for (int i = 0; i < 4; i++) m[i] = _mm512_set1_epi64(header[i]);
+	m[4] = _mm512_set1_epi64(nonce);
+
+	// Index of every lane relative to the first, the transposed store uses it as well
+	const __m512i laneIndex = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+
+	for (uint32_t n = 0; n < count; n += 8) 
+	{
+		m[5] = _mm512_add_epi64(_mm512_set1_epi64(first + n), laneIndex);
+
+		__m512i v[16];
+		for (int i = 0; i < 8; i++) 
+		{
+			v[i] = _mm512_set1_epi64(state[i]);
+			v[i+8] = _mm512_set1_epi64(blakeIV[i]);
+		}
+		v[12] = _mm512_set1_epi64(blakeIV[4] ^ blakeMessageLength);
+		v[14] = _mm512_set1_epi64(~blakeIV[6]);
+
+		for (int r = 0; r < 12; r++) 
+		{
+			const uint8_t* s = blakeSigma[r];
+			G(v[0], v[4], v[8],  v[12], m[s[0]],  m[s[1]]);
+			G(v[1], v[5], v[9],  v[13], m[s[2]],  m[s[3]]);
+			G(v[2], v[6], v[10], v[14], m[s[4]],  m[s[5]]);
+			G(v[3], v[7], v[11], v[15], m[s[6]],  m[s[7]]);
+			G(v[0], v[5], v[10], v[15], m[s[8]],  m[s[9]]);
+			G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+			G(v[2], v[7], v[8],  v[13], m[s[12]], m[s[13]]);
+			G(v[3], v[4], v[9],  v[14], m[s[14]], m[s[15]]);
+		}
+
+		// Scatter word i of lane l to out[8*(n+l) + i]
+		const __m512i stride = _mm512_slli_epi64(laneIndex, 3);
+		for (int i = 0; i < 8; i++) 
+		{
+			__m512i h = _mm512_xor_si512(_mm512_set1_epi64(state[i]), _mm512_xor_si512(v[i], v[i+8]));
+			_mm512_i64scatter_epi64(out + 8*n + i, stride, h, 8);
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+}
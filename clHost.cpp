@@ -54,10 +54,21 @@ void CL_CALLBACK CCallbackFunc(cl_event ev, cl_int err , void* data)
 	self->callbackFunc(err, data);
 }
 
-// Function to load the OpenCL kernel and prepare our device for mining
-bool clHost::loadAndCompileKernel(cl::Device &device, uint32_t pl, bool use3G) 
+// Prints a whole line at once, the devices are brought up concurrently
+void clHost::logDevice(uint32_t gpuIndex, string message) 
 {
-	cout << "   Loading and compiling Beam OpenCL Kernel" << endl;
+	stringstream line;
+	line << "Device " << deviceNumbers[gpuIndex] << ": " << message << endl;
+
+	lock_guard<mutex> lock(logMutex);
+	cout << line.str() << flush;
+}
+
+// Builds the program of a pipeline or takes it from the cache if this device and driver built it before
+bool clHost::buildProgram(uint32_t gpuIndex, const clPipeline& pipeline, cl::Program& program, bool verbose) 
+{
+	cl::Device& device = devices[gpuIndex];
+	cl::Context& context = contexts[devicePlatforms[gpuIndex]];
 
 	// reading the kernel
 	string progStr = string(__equihash_150_5_cl, __equihash_150_5_cl_len); 
@@ -68,89 +79,289 @@ bool clHost::loadAndCompileKernel(cl::Device &device, uint32_t pl, bool use3G)
 	vector<cl::Device> devicesTMP;
 	devicesTMP.push_back(device);
 
-	cl::Program program(contexts[pl], source);
-	cl_int err;
-	if (!use3G) 
+	string options = pipeline.buildOptions;
+	if (telemetry) options += (options.empty() ? "" : " ") + string("-DTELEMETRY");
+
+	string cacheKey = clProgramCache::createKey(device, progStr, options);
+
+	if (programCache.load(cacheKey, context, device, program)) 
 	{
-		err = program.build(devicesTMP,"");
+		if (verbose) logDevice(gpuIndex, "Using cached kernel binary");
+
+		return true;
 	}
-	else 
+
+	program = cl::Program(context, source);
+	cl_int err = program.build(devicesTMP, options.c_str());
+
+	if (err) 
 	{
-		err = program.build(devicesTMP,"-DMEM3G");
-	}
-
-	// Check if the build was Ok
-	if (!err) 
-	{
-		cout << "   Build sucessfull. " << endl;
-
-		// Store the device and create a queue for it
-		cl_command_queue_properties queue_prop = 0;  
-		devices.push_back(device);
-		queues.push_back(cl::CommandQueue(contexts[pl], devices[devices.size()-1], queue_prop, NULL)); 
-
-		// Reserve events, space for storing results and so on
-		events.push_back(cl::Event());
-		results.push_back(NULL);
-		currentWork.push_back(clCallbackData());
-		paused.push_back(true);
-		is3G.push_back(use3G);
-		solutionCnt.push_back(0);
-
-		// Create the kernels
-		vector<cl::Kernel> newKernels;	
-		newKernels.push_back(cl::Kernel(program, "clearCounter", &err));
-		newKernels.push_back(cl::Kernel(program, "round0", &err));
-		newKernels.push_back(cl::Kernel(program, "round1", &err));
-		newKernels.push_back(cl::Kernel(program, "round2", &err));
-		newKernels.push_back(cl::Kernel(program, "round3", &err));
-		newKernels.push_back(cl::Kernel(program, "round4", &err));
-		newKernels.push_back(cl::Kernel(program, "round5", &err));
-		if (use3G) 
-		{
-			newKernels.push_back(cl::Kernel(program, "combine3G", &err));
-			newKernels.push_back(cl::Kernel(program, "repack", &err));
-			newKernels.push_back(cl::Kernel(program, "move", &err));
-		} 
-		else 
-		{
-			newKernels.push_back(cl::Kernel(program, "combine", &err));
-		}
-		kernels.push_back(newKernels);
+		// Print error msg so we can debug the kernel source
+		if (verbose) logDevice(gpuIndex, "Program build error, device will not be used. Build Log: " + program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(devicesTMP[0]));
 
-		// Create the buffers
-		vector<cl::Buffer> newBuffers;
-		
-		if (!use3G) 
-		{
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint4) * 71303168, NULL, &err));
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint4) * 71303168, NULL, &err)); 
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint4) * 71303168, NULL, &err)); 
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint2) * 71303168, NULL, &err)); 
-		} 
-		else 
+		return false;
+	}
+
+	programCache.store(cacheKey, program);
+
+	return true;
+}
+
+// Create the kernels of every slot and bind all arguments that do not change between batches
+bool clHost::createKernels(uint32_t gpuIndex, cl::Program& program) 
+{
+	const clPipeline& pipeline = pipelines[gpuIndex];
+	cl_int err = CL_SUCCESS;
+
+	vector< vector<cl::Kernel> > newKernels(queueDepths[gpuIndex]);
+	for (uint32_t slot = 0; slot < queueDepths[gpuIndex]; slot++)
+	{
+		for (const clStage& stage : pipeline.stages) 
 		{
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint4) * 69599232, NULL, &err));
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint4) * 69599232, NULL, &err)); 
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint4) * 52199424, NULL, &err)); 
-			newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint2) * 1, NULL, &err)); 
+			cl::Kernel kernel(program, stage.kernel.c_str(), &err);
+			if (err != CL_SUCCESS) return false;
+
+			for (cl_uint i = 0; i < stage.args.size(); i++) 
+			{
+				const clStageArg& arg = stage.args[i];
+				switch (arg.type) 
+				{
+					case clStageArg::buffer:   kernel.setArg(i, buffers[gpuIndex][arg.value]); break;
+					case clStageArg::counters: kernel.setArg(i, counterBuffers[gpuIndex][slot]); break;
+					case clStageArg::results:  kernel.setArg(i, resultBuffers[gpuIndex][slot]); break;
+					case clStageArg::constant: kernel.setArg(i, (cl_uint) arg.value); break;
+					default: break;	// Header, nonce and target are set per batch
+				}
+			}
+
+			newKernels[slot].push_back(kernel);
 		}
+	}
+	kernels[gpuIndex] = newKernels;
 
-		newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint4) * 256, NULL, &err));   
-		newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint) * 49152, NULL, &err));  
-		newBuffers.push_back(cl::Buffer(contexts[pl], CL_MEM_READ_WRITE,  sizeof(cl_uint) * 324, NULL, &err));  
-		buffers.push_back(newBuffers);		
-		
-		return true;
-	} 
-	else 
+	return true;
+}
+
+// Function to load the OpenCL kernel and prepare our device for mining.
+// Runs on the worker thread of the device, only touches the state of this device
+bool clHost::loadAndCompileKernel(uint32_t gpuIndex) 
+{
+	cl::Device& device = devices[gpuIndex];
+	cl::Context& context = contexts[devicePlatforms[gpuIndex]];
+	const clPipeline& pipeline = pipelines[gpuIndex];
+
+	logDevice(gpuIndex, "Loading and compiling Beam OpenCL Kernel (" + pipeline.name + ")");
+
+	cl::Program program;
+	if (!buildProgram(gpuIndex, pipeline, program, true)) return false;
+
+	logDevice(gpuIndex, "Build sucessfull");
+
+	// Create a queue for the device
+	cl_command_queue_properties queue_prop = profile ? CL_QUEUE_PROFILING_ENABLE : 0;  
+	queues[gpuIndex] = cl::CommandQueue(context, device, queue_prop, NULL); 
+
+	// The side queue signals stale batches to the device while the main queue is busy.
+	// In dual queue mode the counter clearing and the result read back run there as well,
+	// out-of-order if the device supports it, so they overlap with the rounds of other batches
+	cl_command_queue_properties aux_prop = queue_prop;
+	if (dualQueue && (device.getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
 	{
-		cout << "   Program build error, device will not be used. " << endl;
-		// Print error msg so we can debug the kernel source
-		cout << "   Build Log: "     << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(devicesTMP[0]) << endl;
+		aux_prop |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+		logDevice(gpuIndex, "Using out-of-order side queue");
+	}
+	auxQueues[gpuIndex] = cl::CommandQueue(context, device, aux_prop, NULL); 
+
+	// Create the buffers
+	vector<cl::Buffer> newBuffers;
+	for (uint64_t size : pipeline.bufferSizes) 
+	{
+		newBuffers.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, size, NULL, NULL));
+	}
+	buffers[gpuIndex] = newBuffers;		
+
+	// One counter and result buffer for each batch that may be in flight
+	vector<cl::Buffer> newCounterBuffers;
+	vector<cl::Buffer> newResultBuffers;
+	for (uint32_t slot = 0; slot < queueDepths[gpuIndex]; slot++)
+	{
+		newCounterBuffers.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, pipeline.countersSize, NULL, NULL));  
+		newResultBuffers.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, pipeline.resultsSize, NULL, NULL));  
+	}
+	counterBuffers[gpuIndex] = newCounterBuffers;
+	resultBuffers[gpuIndex] = newResultBuffers;
+
+	// The results are read straight into pinned host memory that stays mapped
+	for (uint32_t slot = 0; slot < queueDepths[gpuIndex]; slot++)
+	{
+		results[gpuIndex][slot] = (unsigned*) allocatePinned(gpuIndex, pipeline.resultsSize);
+		if (telemetry) telemetryCounts[gpuIndex][slot] = (unsigned*) allocatePinned(gpuIndex, kernelTelemetry::counters * sizeof(cl_uint));
+	}
+
+	if (!createKernels(gpuIndex, program)) 
+	{
+		logDevice(gpuIndex, "Kernel creation failed, device will not be used.");
 
 		return false;
 	}
+
+	if (autotune) tuneKernels(gpuIndex, program);
+	
+	return true;
+}
+
+// Runs a few batches with fixed headers and nonces on slot 0 and returns solutions per second, 
+// negative if the device refused to run the current kernels
+double clHost::benchmarkKernels(uint32_t gpuIndex) 
+{
+	const uint32_t batches = 8;
+
+	cl_ulong4 work;
+	uint8_t* workBytes = (uint8_t*) &work;
+	for (uint32_t i = 0; i < 32; i++) workBytes[i] = (uint8_t) (37*i + 11);
+
+	// Every solution reaches this target, so the filter does its full work
+	cl_uint8 target;
+	for (uint32_t i = 0; i < 8; i++) target.s[i] = 0xFFFFFFFF;
+
+	uint32_t solutions = 0;
+	std::chrono::steady_clock::time_point start;
+
+	// Batch 0 only warms up the device
+	for (uint32_t b = 0; b <= batches; b++) 
+	{
+		if (b == 1) start = std::chrono::steady_clock::now();
+
+		cl_int err = enqueueStages(gpuIndex, 0, 0, work, b, target, NULL);
+		if (err == CL_SUCCESS) err = queues[gpuIndex].enqueueReadBuffer(resultBuffers[gpuIndex][0], CL_TRUE, 0, pipelines[gpuIndex].resultsSize, results[gpuIndex][0], NULL, NULL);
+		if (err != CL_SUCCESS) return -1;
+
+		if (b > 0) solutions += results[gpuIndex][0][gpuFilter ? 1 : 0];
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return solutions / seconds;
+}
+
+// Tries the tuning candidates of the pipeline one parameter after the other and keeps the 
+// fastest kernel. Candidates the device can not hold or run are skipped.
+void clHost::tuneKernels(uint32_t gpuIndex, cl::Program& program) 
+{
+	clPipeline base = pipelines[gpuIndex];
+	cl::Device& device = devices[gpuIndex];
+	uint64_t maxGroupSize = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+	uint64_t localMemory = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+	logDevice(gpuIndex, "Auto tuning, this takes a while");
+
+	clTuning best = base.tuning;
+	cl::Program bestProgram = program;
+	double bestRate = benchmarkKernels(gpuIndex);
+
+	stringstream ss;
+	ss << fixed << setprecision(2) << "Tuning " << best.toString() << ": " << bestRate << " sol/s";
+	logDevice(gpuIndex, ss.str());
+
+	for (uint32_t step = 0; step < clPipeline::tuningSteps; step++) 
+	{
+		for (const clTuning& tuning : base.tuningCandidates(best, step)) 
+		{
+			clPipeline candidate = base.tuned(tuning);
+			if (!base.accepts(tuning, maxGroupSize, localMemory)) continue;
+
+			cl::Program candidateProgram;
+			if (!buildProgram(gpuIndex, candidate, candidateProgram, false)) continue;
+
+			pipelines[gpuIndex] = candidate;
+			if (!createKernels(gpuIndex, candidateProgram)) continue;
+
+			double rate = benchmarkKernels(gpuIndex);
+
+			stringstream ss;
+			ss << fixed << setprecision(2) << "Tuning " << tuning.toString() << ": ";
+			if (rate < 0) ss << "failed"; else ss << rate << " sol/s";
+			logDevice(gpuIndex, ss.str());
+
+			if (rate > bestRate) 
+			{
+				bestRate = rate;
+				best = tuning;
+				bestProgram = candidateProgram;
+			}
+		}
+	}
+
+	pipelines[gpuIndex] = base.tuned(best);
+	createKernels(gpuIndex, bestProgram);
+
+	logDevice(gpuIndex, "Using " + best.toString());
+
+	tuningProfiles.store(profileKeys[gpuIndex], {pipelines[gpuIndex].name, best, queueDepths[gpuIndex], dutyCycles[gpuIndex]->getTarget()});
+}
+
+// Allocates host memory the device can write to directly. The buffer is mapped once and 
+// stays mapped, reads into it use the pinned path of the driver without a map per batch
+void* clHost::allocatePinned(uint32_t gpuIndex, size_t size) 
+{
+	cl::Buffer buffer(contexts[devicePlatforms[gpuIndex]], CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size, NULL, NULL);
+	void* hostPtr = queues[gpuIndex].enqueueMapBuffer(buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size, NULL, NULL, NULL);
+	memset(hostPtr, 0, size);
+
+	pinnedBuffers[gpuIndex].push_back(buffer);
+
+	return hostPtr;
+}
+
+// Reserve the state of a device that passed the checks. The heavy part of 
+// the setup is left to the worker thread of the device.
+void clHost::addDevice(cl::Device &device, uint32_t pl, uint32_t number, const clPipeline& pipeline, uint32_t depth, int32_t intensity, string profileKey) 
+{
+	devices.push_back(device);
+	devicePlatforms.push_back(pl);
+	deviceNumbers.push_back(number);
+	pipelines.push_back(gpuFilter ? pipeline.filtered() : pipeline);
+	queueDepths.push_back(depth);
+	profileKeys.push_back(profileKey);
+	dutyCycles.push_back(unique_ptr<dutyCycle>(new dutyCycle(intensity, depth)));
+
+	vector<string> stageNames;
+	for (const clStage& stage : pipelines.back().stages) stageNames.push_back(stage.kernel);
+	profilers.push_back(unique_ptr<stageProfiler>(new stageProfiler(stageNames)));
+	telemetries.push_back(unique_ptr<kernelTelemetry>(new kernelTelemetry()));
+
+	queues.emplace_back();
+	auxQueues.emplace_back();
+	buffers.emplace_back();
+	counterBuffers.emplace_back();
+	resultBuffers.emplace_back();
+	pinnedBuffers.emplace_back();
+	kernels.emplace_back();
+
+	// Reserve events, space for storing results and so on
+	events.push_back(vector<cl::Event>(depth));
+	clearEvents.push_back(vector<cl::Event>(depth));
+	combineEvents.push_back(vector<cl::Event>(depth));
+	abortEvents.push_back(vector<cl::Event>(depth));
+	stageEvents.push_back(vector< vector<cl::Event> >(depth, vector<cl::Event>(pipelines.back().stages.size())));
+	results.push_back(vector<unsigned*>(depth, NULL));
+	telemetryCounts.push_back(vector<unsigned*>(depth, NULL));
+	telemetryRead.push_back(vector<uint8_t>(depth, false));
+	currentWork.push_back(vector<clCallbackData>(depth));
+	paused.push_back(vector<uint8_t>(depth, true));
+	workerQueues.emplace_back();
+	solutionCnt.emplace_back(0);
+	batchCnt.emplace_back(0);
+	staleCnt.emplace_back(0);
+	invalidCnt.emplace_back(0);
+	deviceState.emplace_back(deviceStarting);
+
+	for (uint32_t slot = 0; slot < depth; slot++)
+	{
+		currentWork.back()[slot].gpuIndex = devices.size()-1;
+		currentWork.back()[slot].slot = slot;
+		currentWork.back()[slot].clHost = (void*) this;
+	}
 }
 
 // Detect the OpenCL hardware on this system
@@ -220,11 +431,17 @@ void clHost::detectPlatformDevices(vector<int32_t> selectedDevices, vector<int32
 			{
 				// Check if the CPU / GPU has enough memory
 				uint64_t deviceMemory = nDev[di].getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
-				uint64_t needed_4G = 7* ((uint64_t) 570425344) + 4096 + 196608 + 1296;
-				uint64_t needed_3G = 4* ((uint64_t) 556793856) + ((uint64_t) 835190784) + 4096 + 196608 + 1296;
-
 				cout << "   Device reports " << deviceMemory / (1024*1024) << "MByte total memory" << endl;
 
+				// Settings of an earlier tuning run, explicit parameters take precedence
+				string profileKey = tuningStore::createKey(name, nDev[di].getInfo<CL_DRIVER_VERSION>(), deviceMemory);
+				tuningProfile profile;
+				bool hasProfile = !autotune && tuningProfiles.load(profileKey, profile);
+
+				uint32_t depth = queueDepth;
+				if (depth == 0) depth = (hasProfile && (profile.queueDepth >= 1) && (profile.queueDepth <= 3)) ? profile.queueDepth : 2;
+				if (intensity == 0) intensity = (hasProfile && (profile.intensity >= 1) && (profile.intensity <= 100)) ? profile.intensity : 100;
+
 				if ( hasExtension(nDev[di], "cl_amd_device_attribute_query") ) 
 				{
 					uint64_t freeDeviceMemory;
@@ -234,23 +451,63 @@ void clHost::detectPlatformDevices(vector<int32_t> selectedDevices, vector<int32
 					deviceMemory = min<uint64_t>(deviceMemory, freeDeviceMemory);
 				}				
 
-				bool loadedKernel = false;
-				if ((deviceMemory > needed_4G) && (!force3G)) 
-				{ 
-					cout << "   Memory check for 4G kernel passed" << endl;
-					loadedKernel = loadAndCompileKernel(nDev[di], pl, false);
-				} 
-				else if (deviceMemory > needed_3G) 
+				// Take the tuned variant of the profile if it still fits. The file may be edited or come from 
+				// another build, a tuning the kernels can not run with falls back to the default selection.
+				bool memoryPassed = false;
+				const clPipeline* profilePipeline = hasProfile ? findPipeline(profile.pipeline) : NULL;
+				if ((profilePipeline != NULL) && !profilePipeline->accepts(profile.tuning, nDev[di].getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(), nDev[di].getInfo<CL_DEVICE_LOCAL_MEM_SIZE>())) 
+				{
+					cout << "   Tuning profile " << profile.tuning.toString() << " is not valid for the " << profilePipeline->name << " kernel, ignored" << endl;
+					profilePipeline = NULL;
+				}
+				if ((profilePipeline != NULL) && (!force3G || (profilePipeline->name == "3G"))) 
 				{
-					cout << "   Memory check for 3G kernel passed" << endl;
-					loadedKernel = loadAndCompileKernel(nDev[di], pl, true);
-				}  
-				else 
+					clPipeline pipeline = profilePipeline->tuned(profile.tuning);
+					if (deviceMemory > pipeline.memoryNeeded(depth)) 
+					{
+						cout << "   Applying tuning profile: " << pipeline.name << " kernel, " << profile.tuning.toString() << ", queue depth " << depth << ", intensity " << intensity << "%" << endl;
+						memoryPassed = true;
+						addDevice(nDev[di], pl, currentDevice, pipeline, depth, intensity, profileKey);
+					}
+				}
+
+				// Otherwise take the first variant that fits into the device memory
+				uint64_t minimumNeeded = UINT64_MAX;
+				for (const clPipeline& pipeline : clPipelines()) 
 				{
-					cout << "   Memory check failed, required minimum memory: " << needed_3G/(1024*1024) << endl;
+					if (memoryPassed) break;
+					if (force3G && (pipeline.name != "3G")) continue;
+
+					uint64_t needed = pipeline.memoryNeeded(depth);
+					minimumNeeded = min<uint64_t>(minimumNeeded, needed);
+
+					if (deviceMemory > needed) 
+					{
+						cout << "   Memory check for " << pipeline.name << " kernel passed" << endl;
+						memoryPassed = true;
+
+						// Large scratch areas may need more local memory than the device has
+						uint64_t localMemory = nDev[di].getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+						clPipeline fitted = pipeline.fitted(localMemory);
+						if (fitted.localMemoryNeeded() > localMemory) 
+						{
+							cout << "   Kernel needs more local memory than the device has, device will not be used" << endl;
+							break;
+						}
+						if (!(fitted.tuning == pipeline.tuning)) 
+						{
+							cout << "   Scratch size reduced to " << fitted.tuning.scratchSize << ", group size " << fitted.tuning.groupSize << " to fit into local memory" << endl;
+						}
+
+						addDevice(nDev[di], pl, currentDevice, fitted, depth, intensity, profileKey);
+						break;
+					}
 				}
 
-				if (loadedKernel) intensities.push_back(intensity);
+				if (!memoryPassed) 
+				{
+					cout << "   Memory check failed, required minimum memory: " << minimumNeeded/(1024*1024) << endl;
+				}
 			} 
 			else 
 			{
@@ -261,7 +518,7 @@ void clHost::detectPlatformDevices(vector<int32_t> selectedDevices, vector<int32
 		}
 	}
 
-	if (devices.size() == 0) 
+	if ((devices.size() == 0) && (cpuThreads == 0)) 
 	{
 		cout << "No compatible OpenCL devices found or all are deselected. Exiting..." << endl;
 		exit(0);
@@ -273,9 +530,26 @@ clHost::clHost(
 	beamStratum* minerStratumIn, 
 	vector<int32_t> selectedDevices, 
 	vector<int32_t> selectedIntensities, 
+	uint32_t queueDepthIn,
+	bool dualQueueIn,
+	bool profileIn,
+	bool telemetryIn,
+	bool gpuFilterIn,
+	bool autotuneIn,
 	bool allowCPU, 
-	bool force3G) 
+	uint32_t cpuThreadsIn,
+	bool force3G,
+	string kernelCacheDir,
+	string tuningFile) : programCache(kernelCacheDir), tuningProfiles(tuningFile)
 {
+	queueDepth = queueDepthIn;
+	dualQueue = dualQueueIn;
+	profile = profileIn;
+	telemetry = telemetryIn;
+	gpuFilter = gpuFilterIn;
+	autotune = autotuneIn;
+	cpuThreads = cpuThreadsIn;
+
 	workCounterMinModulo = 960;
 	workCounterMaxModulo = 1000;
 
@@ -285,6 +559,117 @@ clHost::clHost(
 	minerStratum = minerStratumIn;
 	
 	detectPlatformDevices(selectedDevices, selectedIntensities, allowCPU, force3G);
+
+	// Let the workers drop the batches of replaced jobs
+	minerStratum->addJobListener([this]() 
+	{
+		for (size_t i = 0; i < devices.size(); i++) 
+		{
+			if (deviceState[i] != deviceFailed) postMessage(i, {clWorkerMessage::newJob, 0});
+		}
+	});
+
+	// One host worker for each device, it compiles the kernels and allocates the buffers 
+	// of its device in parallel to the others and starts mining as soon as it is done
+	for (size_t i = 0; i < devices.size(); i++) 
+	{
+		thread(&clHost::workerFunc, this, i).detach();
+	}
+
+	if (cpuThreads > 0) 
+	{
+		cout << "CPU solver: " << cpuThreads << " threads" << endl;
+		thread(&clHost::cpuWorkerFunc, this).detach();
+	}
+}
+
+// One CPU solver for all hosts, only the host that is mining has work for it
+static mutex cpuSolverMutex;
+static unique_ptr<equihashCpu> cpuSolver;
+
+// Solves one nonce after the other on the host CPU, a job change stops the current nonce
+void clHost::cpuWorkerFunc() 
+{
+	while (true) 
+	{
+		if (!minerStratum->hasWork()) 
+		{
+			this_thread::sleep_for(std::chrono::milliseconds(200));
+			continue;
+		}
+
+		lock_guard<mutex> lock(cpuSolverMutex);
+		if (!cpuSolver) 
+		{
+			try 
+			{
+				cpuSolver.reset(new equihashCpu(cpuThreads));
+			} 
+			catch (bad_alloc&) 
+			{
+				cout << "Not enough memory for the CPU solver, it needs about 4GB" << endl;
+				return;
+			}
+		}
+
+		beamStratum::WorkDescription work;
+		uint8_t header[32];
+		minerStratum->getWork(work, header);
+
+		vector< vector<uint32_t> > solutions;
+		if (!cpuSolver->solve(header, work.nonce, [this, &work]() { return !minerStratum->isCurrent(work); }, solutions)) continue;
+
+		vector< vector<uint32_t> > verified;
+		for (vector<uint32_t>& indexes : solutions) 
+		{
+			if (!verifySolution(header, work.nonce, indexes)) 
+			{
+				cpuInvalidCnt++;
+				continue;
+			}
+
+			verified.push_back(std::move(indexes));
+		}
+
+		minerStratum->handleSolutions(work, verified);
+		cpuSolutionCnt += verified.size();
+	}
+}
+
+// Event of a pipeline stage if anything needs to wait for it or profile it, NULL otherwise
+cl::Event* clHost::stageEvent(uint32_t gpuIndex, uint32_t slot, size_t stage) 
+{
+	if ((stage == 0) && dualQueue) return &clearEvents[gpuIndex][slot];
+	if (stage == pipelines[gpuIndex].stages.size()-1) return &combineEvents[gpuIndex][slot];
+	if (profile) return &stageEvents[gpuIndex][slot][stage];
+
+	return NULL;
+}
+
+// Clears the counters and the result of a slot. In dual queue mode this runs on the side
+// queue as soon as the slot was released, independent of the rounds of the other slots
+void clHost::queueClear(uint32_t gpuIndex, uint32_t slot) 
+{
+	const clStage& stage = pipelines[gpuIndex].stages[0];
+	cl::Kernel& kernel = kernels[gpuIndex][slot][0];
+
+	// The abort word of the last batch must be written before it gets cleared again
+	vector<cl::Event> slotReleased;
+	if (abortEvents[gpuIndex][slot]() != NULL) 
+	{
+		slotReleased.push_back(abortEvents[gpuIndex][slot]);
+		abortEvents[gpuIndex][slot] = cl::Event();
+	}
+
+	if (dualQueue) 
+	{
+		auxQueues[gpuIndex].enqueueNDRangeKernel(kernel, cl::NDRange(0), cl::NDRange(stage.globalSize), cl::NDRange(stage.localSize), slotReleased.empty() ? NULL : &slotReleased, stageEvent(gpuIndex, slot, 0));
+		auxQueues[gpuIndex].flush();
+	}
+	else
+	{
+		queues[gpuIndex].enqueueNDRangeKernel(kernel, cl::NDRange(0), cl::NDRange(stage.globalSize), cl::NDRange(stage.localSize), slotReleased.empty() ? NULL : &slotReleased, stageEvent(gpuIndex, slot, 0));
+	}
 }
 
 // Function that will catch new work from the stratum interface and then queue the work on the device
@@ -292,204 +677,280 @@ void clHost::queueKernels(uint32_t gpuIndex, clCallbackData* workData)
 {
 	cl_ulong4 work;	
 	cl_ulong nonce;
+	cl_uint8 target;
+	uint32_t slot = workData->slot;
 
 	// Get a new set of work from the stratum interface
 	workData->stratum->getWork(workData->workDescription, (uint8_t *) &work);
+	memcpy(workData->header, &work, 32);
 	nonce = workData->workDescription.nonce;
+	workData->workDescription.target.thresholdWords(target.s);
 
-	if (!is3G[gpuIndex]) 
-	{		
-		// Starting the 4G kernels
-		
-		// Kernel arguments for cleanCounter
-		kernels[gpuIndex][0].setArg(0, buffers[gpuIndex][5]); 
-		kernels[gpuIndex][0].setArg(1, buffers[gpuIndex][6]);
-
-		// Kernel arguments for round0
-		kernels[gpuIndex][1].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][1].setArg(1, buffers[gpuIndex][2]); 
-		kernels[gpuIndex][1].setArg(2, buffers[gpuIndex][5]); 
-		kernels[gpuIndex][1].setArg(3, work); 
-		kernels[gpuIndex][1].setArg(4, nonce); 
-
-		// Kernel arguments for round1
-		kernels[gpuIndex][2].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][2].setArg(1, buffers[gpuIndex][2]); 
-		kernels[gpuIndex][2].setArg(2, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][2].setArg(3, buffers[gpuIndex][3]); 	// Index tree will be stored here
-		kernels[gpuIndex][2].setArg(4, buffers[gpuIndex][5]); 
-
-		// Kernel arguments for round2
-		kernels[gpuIndex][3].setArg(0, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][3].setArg(1, buffers[gpuIndex][0]);	// Index tree will be stored here 
-		kernels[gpuIndex][3].setArg(2, buffers[gpuIndex][5]); 
-
-		// Kernel arguments for round3
-		kernels[gpuIndex][4].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][4].setArg(1, buffers[gpuIndex][1]); 	// Index tree will be stored here 
-		kernels[gpuIndex][4].setArg(2, buffers[gpuIndex][5]); 
-
-		// Kernel arguments for round4
-		kernels[gpuIndex][5].setArg(0, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][5].setArg(1, buffers[gpuIndex][2]); 	// Index tree will be stored here 
-		kernels[gpuIndex][5].setArg(2, buffers[gpuIndex][5]);  
-
-		// Kernel arguments for round5
-		kernels[gpuIndex][6].setArg(0, buffers[gpuIndex][2]); 
-		kernels[gpuIndex][6].setArg(1, buffers[gpuIndex][4]); 	// Index tree will be stored here 
-		kernels[gpuIndex][6].setArg(2, buffers[gpuIndex][5]);  
-
-		// Kernel arguments for Combine
-		kernels[gpuIndex][7].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][7].setArg(1, buffers[gpuIndex][1]); 	
-		kernels[gpuIndex][7].setArg(2, buffers[gpuIndex][2]); 
-		kernels[gpuIndex][7].setArg(3, buffers[gpuIndex][3]); 	
-		kernels[gpuIndex][7].setArg(4, buffers[gpuIndex][4]); 
-		kernels[gpuIndex][7].setArg(5, buffers[gpuIndex][5]); 	
-		kernels[gpuIndex][7].setArg(6, buffers[gpuIndex][6]);
-
-		cl_int err;
-
-		// Queue the kernels
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][0], cl::NDRange(0), cl::NDRange(12288), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][1], cl::NDRange(0), cl::NDRange(22369536), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][2], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		queues[gpuIndex].flush();
+	queueClear(gpuIndex, slot);
 
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][3], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][4], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][5], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][6], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][7], cl::NDRange(0), cl::NDRange(4096), cl::NDRange(16), NULL, NULL);
-	} 
-	else 
-	{	
-		// Starting the 3G kernels
-		
-		// Kernel arguments for cleanCounter
-		kernels[gpuIndex][0].setArg(0, buffers[gpuIndex][5]); 
-		kernels[gpuIndex][0].setArg(1, buffers[gpuIndex][6]);
-
-		// Kernel arguments for round0
-		kernels[gpuIndex][1].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][1].setArg(1, buffers[gpuIndex][5]); 
-		kernels[gpuIndex][1].setArg(2, work); 
-		kernels[gpuIndex][1].setArg(3, nonce); 
-		kernels[gpuIndex][1].setArg(4, (cl_uint) 0); 
-
-		 // Kernel arguments for round1
-		kernels[gpuIndex][2].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][2].setArg(1, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][2].setArg(2, buffers[gpuIndex][2]);  // Index tree will be stored here 
-		kernels[gpuIndex][2].setArg(3, buffers[gpuIndex][5]); 
-		kernels[gpuIndex][2].setArg(4, (cl_uint) 0); 
-
-		// Kernel arguments for round2
-		kernels[gpuIndex][3].setArg(0, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][3].setArg(1, buffers[gpuIndex][0]);	// Index tree will be stored here 
-		kernels[gpuIndex][3].setArg(2, buffers[gpuIndex][5]); 
-
-		// Kernel arguments for move
-		kernels[gpuIndex][9].setArg(0, buffers[gpuIndex][2]); 
-		kernels[gpuIndex][9].setArg(1, buffers[gpuIndex][1]); 	
-
-		// Kernel arguments for repack
-		kernels[gpuIndex][8].setArg(0, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][8].setArg(1, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][8].setArg(2, buffers[gpuIndex][2]); 	// Index tree will be stored here 	
-
-		// Kernel arguments for round3
-		kernels[gpuIndex][4].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][4].setArg(1, buffers[gpuIndex][1]); 	// Index tree will be stored here 
-		kernels[gpuIndex][4].setArg(2, buffers[gpuIndex][5]); 
-
-		// Kernel arguments for round4
-		kernels[gpuIndex][5].setArg(0, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][5].setArg(1, buffers[gpuIndex][0]); 	// Index tree will be stored here 
-		kernels[gpuIndex][5].setArg(2, buffers[gpuIndex][5]);  
-
-		// Kernel arguments for round5
-		kernels[gpuIndex][6].setArg(0, buffers[gpuIndex][0]); 
-		kernels[gpuIndex][6].setArg(1, buffers[gpuIndex][4]); 	// Index tree will be stored here 
-		kernels[gpuIndex][6].setArg(2, buffers[gpuIndex][5]);  
-
-		// Kernel arguments for Combine
-		kernels[gpuIndex][7].setArg(0, buffers[gpuIndex][1]); 
-		kernels[gpuIndex][7].setArg(1, buffers[gpuIndex][2]); 	
-		kernels[gpuIndex][7].setArg(2, buffers[gpuIndex][4]);  
-		kernels[gpuIndex][7].setArg(3, buffers[gpuIndex][5]); 	
-		kernels[gpuIndex][7].setArg(4, buffers[gpuIndex][6]);
-
-		cl_int err;
-
-		// Queue the kernels
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][0], cl::NDRange(0), cl::NDRange(12288), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][1], cl::NDRange(0), cl::NDRange(22369536), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][2], cl::NDRange(0), cl::NDRange(8388608), cl::NDRange(256), NULL, NULL);
-		queues[gpuIndex].flush();
-		
-		kernels[gpuIndex][1].setArg(4, (cl_uint) 1); 
-		kernels[gpuIndex][2].setArg(4, (cl_uint) 1); 
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][1], cl::NDRange(0), cl::NDRange(22369536), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][2], cl::NDRange(0), cl::NDRange(8388608), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][3], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][9], cl::NDRange(0), cl::NDRange(34799616), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][8], cl::NDRange(0), cl::NDRange(69599232), cl::NDRange(256), NULL, NULL);
-		queues[gpuIndex].flush();
-		
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][4], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][5], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][6], cl::NDRange(0), cl::NDRange(16777216), cl::NDRange(256), NULL, NULL);
-		err = queues[gpuIndex].enqueueNDRangeKernel(kernels[gpuIndex][7], cl::NDRange(0), cl::NDRange(4096), cl::NDRange(16), NULL, NULL); 
-	}	
+	// In dual queue mode round0 has to wait for the counters cleared on the side queue
+	vector<cl::Event> clearDone;
+	if (dualQueue) clearDone.push_back(clearEvents[gpuIndex][slot]);
+
+	// Walk through the remaining stages, the last one signals the result read back
+	enqueueStages(gpuIndex, slot, 1, work, nonce, target, dualQueue ? &clearDone : NULL);
+}
+
+// Enqueues the stages of a slot starting at the given one on the main queue
+cl_int clHost::enqueueStages(uint32_t gpuIndex, uint32_t slot, size_t first, cl_ulong4 work, cl_ulong nonce, cl_uint8 target, vector<cl::Event>* firstWait) 
+{
+	const vector<clStage>& stages = pipelines[gpuIndex].stages;
+	cl_int result = CL_SUCCESS;
+
+	for (size_t s = first; s < stages.size(); s++) 
+	{
+		cl::Kernel& kernel = kernels[gpuIndex][slot][s];
+
+		for (cl_uint i = 0; i < stages[s].args.size(); i++) 
+		{
+			if (stages[s].args[i].type == clStageArg::header) kernel.setArg(i, work);
+			if (stages[s].args[i].type == clStageArg::nonce) kernel.setArg(i, nonce);
+			if (stages[s].args[i].type == clStageArg::target) kernel.setArg(i, target);
+		}
+
+		vector<cl::Event>* wait = (s == first) ? firstWait : NULL;
+
+		cl_int err = queues[gpuIndex].enqueueNDRangeKernel(kernel, cl::NDRange(0), cl::NDRange(stages[s].globalSize), cl::NDRange(stages[s].localSize), wait, stageEvent(gpuIndex, slot, s));
+		if (result == CL_SUCCESS) result = err;
+
+		if (stages[s].flush) queues[gpuIndex].flush();
+	}
+
+	return result;
 }
 
+// Queues one batch into the given slot. The in-order queue keeps the batches of all 
+// slots behind each other, so the device has the next batch ready when one finishes
 void clHost::queueWork(uint32_t gpuIndex, clCallbackData* workData) 
 {
+	uint32_t slot = workData->slot;
+
 	queueKernels(gpuIndex, workData);
 
-	results[gpuIndex] = (unsigned *)queues[gpuIndex].enqueueMapBuffer(buffers[gpuIndex][6], CL_FALSE, CL_MAP_READ, 0, sizeof(cl_uint4) * 81, NULL, &events[gpuIndex], NULL);
-	events[gpuIndex].setCallback(CL_COMPLETE, &CCallbackFunc, (void*) workData);
-	queues[gpuIndex].flush();
+	if (dualQueue)
+	{
+		// Read the results back on the side queue, the main queue continues with the next slot
+		vector<cl::Event> combineDone(1, combineEvents[gpuIndex][slot]);
+		queues[gpuIndex].flush();
+
+		readTelemetry(gpuIndex, slot, auxQueues[gpuIndex], combineDone);
+		auxQueues[gpuIndex].enqueueReadBuffer(resultBuffers[gpuIndex][slot], CL_FALSE, 0, pipelines[gpuIndex].resultsSize, results[gpuIndex][slot], &combineDone, &events[gpuIndex][slot]);
+		events[gpuIndex][slot].setCallback(CL_COMPLETE, &CCallbackFunc, (void*) workData);
+		auxQueues[gpuIndex].flush();
+	}
+	else
+	{
+		vector<cl::Event> telemetryDone;
+		readTelemetry(gpuIndex, slot, queues[gpuIndex], telemetryDone);
+
+		queues[gpuIndex].enqueueReadBuffer(resultBuffers[gpuIndex][slot], CL_FALSE, 0, pipelines[gpuIndex].resultsSize, results[gpuIndex][slot], telemetryDone.empty() ? NULL : &telemetryDone, &events[gpuIndex][slot]);
+		events[gpuIndex][slot].setCallback(CL_COMPLETE, &CCallbackFunc, (void*) workData);
+		queues[gpuIndex].flush();
+	}
+
+	dutyCycles[gpuIndex]->batchQueued(slot);
 
 	workCounter++;
 }
 
-// this function will sumit the solutions done on GPU, then fetch new work and restart mining
+// Called on the OpenCL runtime thread, only hands the finished slot to the worker of the device
 void clHost::callbackFunc(cl_int err , void* data)
 {
 	clCallbackData* workInfo = (clCallbackData*) data;
-	uint32_t gpuIndex = workInfo->gpuIndex;
 
-	// Read the number of solutions of the last iteration
-	uint32_t solutions = results[gpuIndex][0];
-	for (uint32_t  i = 0; i < solutions; i++) 
+	postMessage(workInfo->gpuIndex, {clWorkerMessage::batchDone, workInfo->slot});
+}
+
+void clHost::postMessage(uint32_t gpuIndex, clWorkerMessage message)
+{
+	clWorkerQueue& workerQueue = workerQueues[gpuIndex];
+	{
+		lock_guard<mutex> lock(workerQueue.lock);
+		workerQueue.messages.push_back(message);
+	}
+	workerQueue.wakeUp.notify_one();
+}
+
+// Host worker of a device. All queue operations of a device happen on this thread,
+// so a slow submit path on one device never delays the relaunch of another one
+void clHost::workerFunc(uint32_t gpuIndex)
+{
+	clWorkerQueue& workerQueue = workerQueues[gpuIndex];
+
+	if (!loadAndCompileKernel(gpuIndex)) 
+	{
+		deviceState[gpuIndex] = deviceFailed;
+
+		if (++failedDevices == devices.size()) 
+		{
+			logDevice(gpuIndex, "No device left that could be set up. Exiting...");
+			exit(0);
+		}
+
+		return;
+	}
+
+	// Messages posted during the setup, like the initial resume, are handled from here on
+	deviceState[gpuIndex] = deviceReady;
+	logDevice(gpuIndex, "Ready for mining");
+
+	while (true)
+	{
+		clWorkerMessage message;
+		{
+			unique_lock<mutex> lock(workerQueue.lock);
+			workerQueue.wakeUp.wait(lock, [&workerQueue] { return !workerQueue.messages.empty(); });
+
+			message = workerQueue.messages.front();
+			workerQueue.messages.pop_front();
+		}
+
+		if (message.type == clWorkerMessage::batchDone)
+		{
+			processResults(gpuIndex, message.slot);
+			startSlot(gpuIndex, message.slot);
+		}
+		else if (message.type == clWorkerMessage::newJob)
+		{
+			// Stop the batches of the old job between their rounds and start the new one
+			for (uint32_t slot = 0; slot < queueDepths[gpuIndex]; slot++)
+			{
+				if (paused[gpuIndex][slot]) 
+				{
+					startSlot(gpuIndex, slot);
+				}
+				else if (!minerStratum->isCurrent(currentWork[gpuIndex][slot].workDescription)) 
+				{
+					abortSlot(gpuIndex, slot);
+				}
+			}
+		}
+		else
+		{
+			// Try to wake up all paused slots of this device
+			for (uint32_t slot = 0; slot < queueDepths[gpuIndex]; slot++)
+			{
+				if (paused[gpuIndex][slot]) startSlot(gpuIndex, slot);
+			}
+		}
+	}
+}
+
+// Sets the abort word of a slot from the side queue, the work groups of the remaining rounds then return
+// at once. The write races the kernels on the main queue and OpenCL gives no guarantee when, or whether,
+// a running batch sees it, so this is only a hint. Stale batches are still dropped by their epoch.
+void clHost::abortSlot(uint32_t gpuIndex, uint32_t slot)
+{
+	static const cl_uint abortValue = 1;
+
+	if (abortEvents[gpuIndex][slot]() != NULL) return;
+
+	auxQueues[gpuIndex].enqueueWriteBuffer(counterBuffers[gpuIndex][slot], CL_FALSE, pipelines[gpuIndex].abortOffset, sizeof(cl_uint), &abortValue, NULL, &abortEvents[gpuIndex][slot]);
+	auxQueues[gpuIndex].flush();
+}
+
+// Reads the device timestamps of all stages of a finished batch
+void clHost::profileSlot(uint32_t gpuIndex, uint32_t slot)
+{
+	for (size_t s = 0; s < pipelines[gpuIndex].stages.size(); s++) 
 	{
-		vector<uint32_t> indexes;
-		indexes.assign(32,0);
-		memcpy(indexes.data(), &results[gpuIndex][4 + 32*i], sizeof(uint32_t) * 32);
+		cl::Event* event = stageEvent(gpuIndex, slot, s);
+		if ((event == NULL) || ((*event)() == NULL)) continue;
 
-		workInfo->stratum->handleSolution(workInfo->workDescription, indexes);
+		cl_ulong start = event->getProfilingInfo<CL_PROFILING_COMMAND_START>();
+		cl_ulong end = event->getProfilingInfo<CL_PROFILING_COMMAND_END>();
+		if (end > start) profilers[gpuIndex]->add(s, end - start);
 	}
+}
 
-	solutionCnt[gpuIndex] += solutions;
+// Queues a non-blocking read of the overflow counters into the pinned memory of the slot. It waits 
+// for the given events and is added to them, so the results read of the batch completes after it 
+// and processResults finds both. Nothing blocks the worker or the queues of other slots.
+void clHost::readTelemetry(uint32_t gpuIndex, uint32_t slot, cl::CommandQueue& queue, vector<cl::Event>& readDone)
+{
+	telemetryRead[gpuIndex][slot] = false;
+	if (!telemetry) return;
+
+	cl::Event event;
+	cl_int err = queue.enqueueReadBuffer(counterBuffers[gpuIndex][slot], CL_FALSE, pipelines[gpuIndex].telemetryOffset, kernelTelemetry::counters * sizeof(cl_uint), telemetryCounts[gpuIndex][slot], readDone.empty() ? NULL : &readDone, &event);
+	if (err != CL_SUCCESS) return;
+
+	telemetryRead[gpuIndex][slot] = true;
+	readDone.push_back(event);
+}
+
+// this function will sumit the solutions done on GPU
+void clHost::processResults(uint32_t gpuIndex, uint32_t slot)
+{
+	clCallbackData* workInfo = &currentWork[gpuIndex][slot];
+	unsigned* result = results[gpuIndex][slot];
+
+	dutyCycles[gpuIndex]->batchCompleted(slot);
+	batchCnt[gpuIndex]++;
+
+	if (workInfo->stratum->isCurrent(workInfo->workDescription)) 
+	{
+		// Read the number of solutions of the last iteration, a corrupted count must not read past the buffer.
+		// With the filter only the shares are in the buffer, word 1 holds the number of all solutions.
+		uint32_t maxSolutions = (pipelines[gpuIndex].resultsSize / 4 - 4) / 32;
+		uint32_t solutions = min<uint32_t>(result[0], maxSolutions);
+		uint32_t found = gpuFilter ? min<uint32_t>(result[1], maxSolutions) : solutions;
+		vector< vector<uint32_t> > verified;
+		for (uint32_t  i = 0; i < solutions; i++) 
+		{
+			vector<uint32_t> indexes;
+			indexes.assign(32,0);
+			memcpy(indexes.data(), &result[4 + 32*i], sizeof(uint32_t) * 32);
+
+			// A kernel bug or corrupted buffer must not turn into rejected shares
+			if (!verifySolution(workInfo->header, workInfo->workDescription.nonce, indexes)) 
+			{
+				invalidCnt[gpuIndex]++;
+				continue;
+			}
+
+			verified.push_back(std::move(indexes));
+		}
+
+		// The share target is checked for the whole batch at once
+		workInfo->stratum->handleSolutions(workInfo->workDescription, verified);
+		solutionCnt[gpuIndex] += found - (solutions - verified.size());
+
+		if (profile) profileSlot(gpuIndex, slot);
+		if (telemetryRead[gpuIndex][slot]) telemetries[gpuIndex]->add(telemetryCounts[gpuIndex][slot]);
+	}
+	else 
+	{
+		// The job changed while the batch was running, its solutions are worthless
+		staleCnt[gpuIndex]++;
+	}
 
-	// give the GPU a breather
-	this_thread::sleep_for(std::chrono::milliseconds(1000 - intensities[gpuIndex]));
+}
 
-	// Get new work and resume working
+// Fetch new work and restart mining on a slot or pause it
+void clHost::startSlot(uint32_t gpuIndex, uint32_t slot)
+{
 	if (minerStratum->hasWork()) 
 	{
-		currentWork[gpuIndex].stratum = minerStratum;
+		// Give the GPU a breather if it shall not run at full duty cycle
+		std::chrono::microseconds idle = dutyCycles[gpuIndex]->idleTime();
+		if (idle.count() > 0) this_thread::sleep_for(idle);
 
-		queues[gpuIndex].enqueueUnmapMemObject(buffers[gpuIndex][6], results[gpuIndex], NULL, NULL);
-		queueWork(gpuIndex, &currentWork[gpuIndex]);
+		paused[gpuIndex][slot] = false;
+		currentWork[gpuIndex][slot].stratum = minerStratum;
+
+		queueWork(gpuIndex, &currentWork[gpuIndex][slot]);
 	}
 	else 
 	{
-		paused[gpuIndex] = true;
-		
-		cout << "Device will be paused, waiting for new work..." << endl;
+		if ((slot == 0) && !paused[gpuIndex][slot]) cout << "Device will be paused, waiting for new work..." << endl;
+
+		paused[gpuIndex][slot] = true;
 	}
 }
 
@@ -505,19 +966,10 @@ void clHost::startMining()
 		this_thread::sleep_for(std::chrono::milliseconds(200));
 	}
 
-	// Start mining initially
+	// Start mining initially, the workers fill all slots of their device
 	for (size_t i = 0; i < devices.size(); i++) 
 	{
-		currentWork[i].gpuIndex = i;
-		currentWork[i].clHost = (void*) this;
-
-		if (minerStratum->hasWork())
-		{
-			paused[i] = false;
-			currentWork[i].stratum = minerStratum;
-
-			queueWork(i, &currentWork[i]);
-		}
+		if (deviceState[i] != deviceFailed) postMessage(i, {clWorkerMessage::resume, 0});
 	}
 
 	// While the mining is running print some statistics and try to wake up paused GPUs
@@ -542,28 +994,79 @@ void clHost::startMining()
 				uint32_t totalSols = 0;
 				for (size_t i = 0; i < devices.size(); i++) 
 				{
-					uint32_t sol = solutionCnt[i];
-					solutionCnt[i] = 0;
+					if (deviceState[i] != deviceReady) 
+					{
+						cout << "- sol/s ";
+						continue;
+					}
+
+					uint32_t sol = solutionCnt[i].exchange(0);
 					totalSols += sol;
 					cout << fixed << setprecision(2) << (double) sol / 15.0 << " sol/s ";
 				}
 
-				if (devices.size() > 1)
+				if (cpuThreads > 0) 
+				{
+					uint32_t sol = cpuSolutionCnt.exchange(0);
+					totalSols += sol;
+					cout << fixed << setprecision(2) << "CPU: " << (double) sol / 15.0 << " sol/s ";
+				}
+
+				if (devices.size() + ((cpuThreads > 0) ? 1 : 0) > 1)
 				{
 					cout << "| Total: " << setprecision(2) << (double) totalSols / 15.0 << " sol/s ";
 				}
+
+				uint32_t batches = 0;
+				uint32_t stale = 0;
+				for (size_t i = 0; i < devices.size(); i++) 
+				{
+					batches += batchCnt[i].exchange(0);
+					stale += staleCnt[i].exchange(0);
+				}
+
+				if (batches > 0)
+				{
+					cout << "| Stale batches: " << setprecision(1) << 100.0 * stale / batches << "% ";
+				}
 				cout << endl;
+
+				// Solutions that failed the host verifier, only shown once there are some
+				for (size_t i = 0; i < devices.size(); i++) 
+				{
+					if (invalidCnt[i] > 0) cout << "Device " << deviceNumbers[i] << " invalid solutions: " << invalidCnt[i] << endl;
+				}
+				if (cpuInvalidCnt > 0) cout << "CPU invalid solutions: " << cpuInvalidCnt << endl;
+
+				// Device time of the kernel stages in ms, mean / p99
+				if (profile) 
+				{
+					for (size_t i = 0; i < devices.size(); i++) 
+					{
+						if (deviceState[i] != deviceReady) continue;
+
+						cout << "Device " << deviceNumbers[i] << " stages (ms mean/p99): " << profilers[i]->report() << endl;
+					}
+				}
+
+				// Elements and candidates the rounds dropped, average per batch
+				if (telemetry) 
+				{
+					for (size_t i = 0; i < devices.size(); i++) 
+					{
+						if (deviceState[i] != deviceReady) continue;
+
+						cout << "Device " << deviceNumbers[i] << " losses per batch: " << telemetries[i]->report() << endl;
+					}
+				}
 			}
 			
-			// Check if there are paused devices and restart them
-			for (size_t i = 0; i < devices.size(); i++) 
+			// Ask the workers to restart paused devices
+			if (minerStratum->hasWork()) 
 			{
-				if (paused[i] && minerStratum->hasWork()) 
+				for (size_t i = 0; i < devices.size(); i++) 
 				{
-					paused[i] = false;
-					currentWork[i].stratum = minerStratum;
-
-					queueWork(i, &currentWork[i]);
+					if (deviceState[i] != deviceFailed) postMessage(i, {clWorkerMessage::resume, 0});
 				}
 			}
 		}
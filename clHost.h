@@ -13,8 +13,22 @@
 #include <map>
 #include <cstdlib>
 #include <climits>
+#include <mutex>
+#include <memory>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 #include "beamStratum.h"
+#include "dutyCycle.h"
+#include "stageProfiler.h"
+#include "kernelTelemetry.h"
+#include "clPipeline.h"
+#include "clProgramCache.h"
+#include "tuningStore.h"
+#include "equihashCpu.h"
+#include "equihashVerifier.h"
 
 namespace beamMiner 
 {
@@ -22,11 +36,28 @@ namespace beamMiner
 struct clCallbackData 
 {
 	uint32_t gpuIndex;
+	uint32_t slot;
 	beamStratum* stratum;
 	beamStratum::WorkDescription workDescription;
+	uint8_t header[32];
 	void* clHost;
 };
 
+struct clWorkerMessage
+{
+	enum { batchDone, resume, newJob } type;
+	uint32_t slot;
+};
+
+// Completion notifications of one device, filled by the OpenCL callback
+// and consumed by the host worker thread of that device
+struct clWorkerQueue
+{
+	mutex lock;
+	condition_variable wakeUp;
+	deque<clWorkerMessage> messages;
+};
+
 class clHost 
 {
 	private:
@@ -34,32 +65,118 @@ class clHost
 	vector<cl::Platform> platforms;  
 	vector<cl::Context> contexts;
 	vector<cl::CommandQueue> queues;
+	vector<cl::CommandQueue> auxQueues;
 	vector<cl::Device> devices;
-	vector<cl::Event> events;
-	vector<unsigned*> results;
+	vector<uint32_t> devicePlatforms;
+	vector<uint32_t> deviceNumbers;
+
+	// Setup progress of each device, the setup runs on the worker threads
+	enum { deviceStarting, deviceReady, deviceFailed };
+	deque< atomic<int> > deviceState;
+	atomic<uint32_t> failedDevices {0};
+	mutex logMutex;
 
 	vector< vector<cl::Buffer> > buffers;
-	vector< vector<cl::Kernel> > kernels;
 
-	vector<bool> is3G;
+	// Compiled kernels from earlier runs
+	clProgramCache programCache;
+
+	// Winning tuning of earlier runs, applied at startup instead of tuning again
+	tuningStore tuningProfiles;
+	vector<string> profileKeys;
+
+	// Kernel objects per device, slot and pipeline stage with their arguments bound once
+	vector<clPipeline> pipelines;
+	vector< vector< vector<cl::Kernel> > > kernels;
+
+	// Per device ring of in-flight batches, each slot has its own counter and result buffer.
+	// The requested depth is zero if the tuning profile or the default decides.
+	uint32_t queueDepth;
+	vector<uint32_t> queueDepths;
+	vector< vector<cl::Buffer> > counterBuffers;
+	vector< vector<cl::Buffer> > resultBuffers;
+	vector< vector<cl::Event> > events;
+
+	// Persistently mapped host memory, the results of each slot are read into it
+	vector< vector<cl::Buffer> > pinnedBuffers;
+	vector< vector<unsigned*> > results;
+
+	// Dual queue mode, events connect the main queue and the side queue
+	bool dualQueue;
+	vector< vector<cl::Event> > clearEvents;
+	vector< vector<cl::Event> > combineEvents;
+
+	// Write of the abort word of a stale batch, the next clear of the slot waits for it
+	vector< vector<cl::Event> > abortEvents;
+
+	// Profiling mode, every stage of every slot gets an event with timestamps
+	bool profile;
+	vector< vector< vector<cl::Event> > > stageEvents;
+	vector< unique_ptr<stageProfiler> > profilers;
+
+	// Telemetry mode, the kernels count the elements they drop and every batch reads the counters
+	bool telemetry;
+	vector< unique_ptr<kernelTelemetry> > telemetries;
+
+	// Pinned copy of the overflow counters of each slot, read together with the results
+	vector< vector<unsigned*> > telemetryCounts;
+	vector< vector<uint8_t> > telemetryRead;
+
+	// Drop solutions below the share target on the device, only shares are read back
+	bool gpuFilter;
+
+	// Benchmark kernel variants on every device before mining
+	bool autotune;
+
+	// Native solver on the host CPU, zero threads if it is not used
+	uint32_t cpuThreads;
+	atomic<uint32_t> cpuSolutionCnt {0};
+	atomic<uint32_t> cpuInvalidCnt {0};
+
+	// Host worker threads, one per device
+	deque<clWorkerQueue> workerQueues;
 
 	// Statistics
-	vector<int> solutionCnt;
+	deque< atomic<uint32_t> > solutionCnt;
+	deque< atomic<uint32_t> > batchCnt;
+	deque< atomic<uint32_t> > staleCnt;
+
+	// Solutions the host verifier rejected since the start
+	deque< atomic<uint32_t> > invalidCnt;
 
-	// To check if a mining thread stoped and we must resume it
-	vector<bool> paused;
+	// To check if a slot of a device stoped and we must resume it, owned by the worker
+	vector< vector<uint8_t> > paused;
 
-	vector<int32_t> intensities;
+	// Target utilization of each device
+	vector< unique_ptr<dutyCycle> > dutyCycles;
 
 	// Callback data
-	vector<clCallbackData> currentWork;
+	vector< vector<clCallbackData> > currentWork;
 	bool restart = true;
 
 	// Functions
 	void detectPlatformDevices(vector<int32_t>, vector<int32_t>, bool, bool);
-	bool loadAndCompileKernel(cl::Device &, uint32_t, bool);
+	void addDevice(cl::Device &, uint32_t, uint32_t, const clPipeline&, uint32_t, int32_t, string);
+	bool buildProgram(uint32_t, const clPipeline&, cl::Program&, bool);
+	bool createKernels(uint32_t, cl::Program&);
+	bool loadAndCompileKernel(uint32_t);
+	double benchmarkKernels(uint32_t);
+	void tuneKernels(uint32_t, cl::Program&);
+	void* allocatePinned(uint32_t, size_t);
+	void logDevice(uint32_t, string);
+	cl::Event* stageEvent(uint32_t, uint32_t, size_t);
+	void queueClear(uint32_t, uint32_t);
 	void queueKernels(uint32_t, clCallbackData*);
+	cl_int enqueueStages(uint32_t, uint32_t, size_t, cl_ulong4, cl_ulong, cl_uint8, vector<cl::Event>*);
 	void queueWork(uint32_t, clCallbackData*); 
+	void postMessage(uint32_t, clWorkerMessage);
+	void workerFunc(uint32_t);
+	void abortSlot(uint32_t, uint32_t);
+	void processResults(uint32_t, uint32_t);
+	void profileSlot(uint32_t, uint32_t);
+	void readTelemetry(uint32_t, uint32_t, cl::CommandQueue&, vector<cl::Event>&);
+	void startSlot(uint32_t, uint32_t);
+	void cpuWorkerFunc();
 	
 	// The connectors
 	beamStratum* minerStratum;
@@ -70,7 +187,7 @@ class clHost
 
 	public:
 	
-	clHost(beamStratum*, vector<int32_t>, vector<int32_t>, bool, bool);
+	clHost(beamStratum*, vector<int32_t>, vector<int32_t>, uint32_t, bool, bool, bool, bool, bool, bool, uint32_t, bool, string, string);
 	void startMining();	
 	void callbackFunc(cl_int, void*);
 };
@@ -0,0 +1,259 @@
+// BEAM OpenCL Miner
+// Declarative description of the kernel pipelines
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "clPipeline.h"
+
+#include <sstream>
+
+namespace beamMiner 
+{
+
+// Short hands to keep the tables readable
+static clStageArg buf(uint32_t index) { return {clStageArg::buffer, index}; }
+static clStageArg cnt() { return {clStageArg::counters, 0}; }
+static clStageArg res() { return {clStageArg::results, 0}; }
+static clStageArg hdr() { return {clStageArg::header, 0}; }
+static clStageArg nce() { return {clStageArg::nonce, 0}; }
+static clStageArg tgt() { return {clStageArg::target, 0}; }
+static clStageArg val(uint32_t value) { return {clStageArg::constant, value}; }
+
+static std::vector<clPipeline> createPipelines() 
+{
+	std::vector<clPipeline> pipelines;
+
+	// 6G: the 4G layout with larger buckets and scratch areas, fewer elements get dropped
+	clPipeline p6G;
+	p6G.name = "6G";
+	p6G.buildOptions = "-DMEM6G";
+	p6G.bufferSizes = {
+		16 * (uint64_t) 83886080,
+		16 * (uint64_t) 83886080,
+		16 * (uint64_t) 83886080,
+		8 * (uint64_t) 83886080,
+		16 * 256
+	};
+	p6G.countersSize = 4 * (49152 + 4 + 24);	// Counters, the abort word and the overflow counters
+	p6G.abortOffset = 4 * 49152;
+	p6G.telemetryOffset = 4 * 49156;
+	p6G.resultsSize = 4 * 324;
+	p6G.maxBucketSize = 10240;
+	p6G.tuning.scratchSize = 1536;
+	p6G.tuning.bucketSize = 9216;
+	p6G.stages = {
+		{"clearCounter", {cnt(), res()}, 12288, 256, false, false},
+		{"round0", {buf(0), buf(2), cnt(), hdr(), nce()}, 22369536, 256, false, false},
+		{"round1", {buf(0), buf(2), buf(1), buf(3), cnt()}, 16777216, 256, true, true},	// Index tree in buffer 3
+		{"round2", {buf(1), buf(0), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 0
+		{"round3", {buf(0), buf(1), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 1
+		{"round4", {buf(1), buf(2), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 2
+		{"round5", {buf(2), buf(4), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 4
+		{"combine", {buf(0), buf(1), buf(2), buf(3), buf(4), cnt(), res()}, 4096, 16, false, false}
+	};
+	pipelines.push_back(p6G);
+
+	// 4G: all round outputs stay in memory, no repacking needed
+	clPipeline p4G;
+	p4G.name = "4G";
+	p4G.buildOptions = "";
+	p4G.bufferSizes = {
+		16 * (uint64_t) 71303168,
+		16 * (uint64_t) 71303168,
+		16 * (uint64_t) 71303168,
+		8 * (uint64_t) 71303168,
+		16 * 256
+	};
+	p4G.countersSize = 4 * (49152 + 4 + 24);	// Counters, the abort word and the overflow counters
+	p4G.abortOffset = 4 * 49152;
+	p4G.telemetryOffset = 4 * 49156;
+	p4G.resultsSize = 4 * 324;
+	p4G.maxBucketSize = 8704;
+	p4G.stages = {
+		{"clearCounter", {cnt(), res()}, 12288, 256, false, false},
+		{"round0", {buf(0), buf(2), cnt(), hdr(), nce()}, 22369536, 256, false, false},
+		{"round1", {buf(0), buf(2), buf(1), buf(3), cnt()}, 16777216, 256, true, true},	// Index tree in buffer 3
+		{"round2", {buf(1), buf(0), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 0
+		{"round3", {buf(0), buf(1), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 1
+		{"round4", {buf(1), buf(2), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 2
+		{"round5", {buf(2), buf(4), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 4
+		{"combine", {buf(0), buf(1), buf(2), buf(3), buf(4), cnt(), res()}, 4096, 16, false, false}
+	};
+	pipelines.push_back(p4G);
+
+	// 3G: round0 and round1 run in two halves, round 1 and 2 outputs get repacked
+	clPipeline p3G;
+	p3G.name = "3G";
+	p3G.buildOptions = "-DMEM3G";
+	p3G.bufferSizes = {
+		16 * (uint64_t) 69599232,
+		16 * (uint64_t) 69599232,
+		16 * (uint64_t) 52199424,
+		8,
+		16 * 256
+	};
+	p3G.countersSize = 4 * (49152 + 4 + 24);	// Counters, the abort word and the overflow counters
+	p3G.abortOffset = 4 * 49152;
+	p3G.telemetryOffset = 4 * 49156;
+	p3G.resultsSize = 4 * 324;
+	p3G.maxBucketSize = 0;
+	p3G.tuning.bucketSize = 8496;
+	p3G.stages = {
+		{"clearCounter", {cnt(), res()}, 12288, 256, false, false},
+		{"round0", {buf(0), cnt(), hdr(), nce(), val(0)}, 22369536, 256, false, false},
+		{"round1", {buf(0), buf(1), buf(2), cnt(), val(0)}, 8388608, 256, true, true},	// Index tree in buffer 2
+		{"round0", {buf(0), cnt(), hdr(), nce(), val(1)}, 22369536, 256, false, false},
+		{"round1", {buf(0), buf(1), buf(2), cnt(), val(1)}, 8388608, 256, false, true},
+		{"round2", {buf(1), buf(0), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 0
+		{"move", {buf(2), buf(1)}, 34799616, 256, false, false},
+		{"repack", {buf(1), buf(0), buf(2)}, 69599232, 256, true, false},			// Index tree in buffer 2
+		{"round3", {buf(0), buf(1), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 1
+		{"round4", {buf(1), buf(0), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 0
+		{"round5", {buf(0), buf(4), cnt()}, 16777216, 256, false, true},			// Index tree in buffer 4
+		{"combine3G", {buf(1), buf(2), buf(4), cnt(), res()}, 4096, 16, false, false}
+	};
+	pipelines.push_back(p3G);
+
+	return pipelines;
+}
+
+const std::vector<clPipeline>& clPipelines() 
+{
+	static const std::vector<clPipeline> pipelines = createPipelines();
+
+	return pipelines;
+}
+
+const clPipeline* findPipeline(const std::string& name) 
+{
+	for (const clPipeline& pipeline : clPipelines()) 
+	{
+		if (pipeline.name == name) return &pipeline;
+	}
+
+	return NULL;
+}
+
+uint64_t clPipeline::memoryNeeded(uint32_t slots) const 
+{
+	uint64_t needed = slots * (countersSize + resultsSize);
+	for (uint64_t size : bufferSizes) needed += size;
+
+	return needed;
+}
+
+// Work-group local memory of the round kernels in bytes: scratch, tab and the counters
+uint64_t clPipeline::localMemoryNeeded() const 
+{
+	return 4 * (6 * (uint64_t) tuning.scratchSize + 512 + 2);
+}
+
+clPipeline clPipeline::tuned(const clTuning& newTuning) const 
+{
+	clPipeline result = *this;
+	result.tuning = newTuning;
+	if (maxBucketSize == 0) result.tuning.bucketSize = tuning.bucketSize;
+
+	result.buildOptions = buildOptions + (buildOptions.empty() ? "" : " ") + result.tuning.buildOptions();
+
+	for (clStage& stage : result.stages) 
+	{
+		if (!stage.tunable) continue;
+
+		stage.globalSize = stage.globalSize / stage.localSize * newTuning.groupSize;
+		stage.localSize = newTuning.groupSize;
+	}
+
+	return result;
+}
+
+// Largest scratch capacity that fits into the local memory of a device, in steps of 64 elements.
+// The scratch area may not get smaller than a work group, below that the group size is halved.
+// If not even 64 threads fit, the result still needs more local memory than the device has.
+clPipeline clPipeline::fitted(uint64_t localMemory) const 
+{
+	clPipeline result = *this;
+	while (result.localMemoryNeeded() > localMemory) 
+	{
+		if (result.tuning.scratchSize > result.tuning.groupSize) result.tuning.scratchSize = (result.tuning.scratchSize - 1) / 64 * 64;
+		else if (result.tuning.groupSize > 64) result.tuning.groupSize /= 2;
+		else break;
+	}
+
+	return (result.tuning == tuning) ? *this : tuned(result.tuning);
+}
+
+// Tunings from a profile file are checked before use: the kernels support work-group sizes of
+// 64, 128 and 256, scratch positions have to stay below the 0xFFF end marker of the tables and a
+// bucket beyond maxBucketSize would write past the buffers. The collision search reads the scratch
+// area up to a group size behind its last element, so it can not be smaller than a group.
+bool clPipeline::accepts(const clTuning& candidate, uint64_t maxGroupSize, uint64_t localMemory) const 
+{
+	bool groupValid = (candidate.groupSize == 64) || (candidate.groupSize == 128) || (candidate.groupSize == 256);
+	bool scratchValid = (candidate.scratchSize >= candidate.groupSize) && (candidate.scratchSize >= 64) && (candidate.scratchSize < 4095);
+	bool bucketValid = (maxBucketSize == 0) || ((candidate.bucketSize > 0) && (candidate.bucketSize <= maxBucketSize));
+
+	if (!groupValid || !scratchValid || !bucketValid || (candidate.groupSize > maxGroupSize)) return false;
+
+	return tuned(candidate).localMemoryNeeded() <= localMemory;
+}
+
+// The filter runs one work-group over the results of combine. It keeps the raw solution count
+// in word 1 and moves the solutions that reach the target to the front
+clPipeline clPipeline::filtered() const 
+{
+	clPipeline result = *this;
+	result.stages.push_back({"filterSolutions", {res(), tgt()}, 16, 16, false, false});
+
+	return result;
+}
+
+// Step 0 varies the work-group size, step 1 the scratch capacity and step 2 the bucket size,
+// each around the defaults of the variant
+std::vector<clTuning> clPipeline::tuningCandidates(const clTuning& base, uint32_t step) const 
+{
+	std::vector<uint32_t> values;
+	if (step == 0) values = {256, 128, 64};
+	if (step == 1) values = {tuning.scratchSize, tuning.scratchSize - 128, tuning.scratchSize + 128};
+	if ((step == 2) && (maxBucketSize != 0)) values = {tuning.bucketSize, tuning.bucketSize - 224, maxBucketSize};
+
+	std::vector<clTuning> candidates;
+	for (uint32_t value : values) 
+	{
+		clTuning candidate = base;
+		if (step == 0) candidate.groupSize = value;
+		if (step == 1) candidate.scratchSize = value;
+		if (step == 2) candidate.bucketSize = value;
+
+		// A scratch area smaller than a work group would be overrun by the collision search
+		if (candidate.scratchSize < candidate.groupSize) continue;
+
+		if (!(candidate == base)) candidates.push_back(candidate);
+	}
+
+	return candidates;
+}
+
+std::string clTuning::buildOptions() const 
+{
+	std::stringstream ss;
+	ss << "-DWG_SIZE=" << groupSize << " -DSCRATCH_SIZE=" << scratchSize << " -DBUCKET_SIZE=" << bucketSize;
+
+	return ss.str();
+}
+
+std::string clTuning::toString() const 
+{
+	std::stringstream ss;
+	ss << "group " << groupSize << ", scratch " << scratchSize << ", bucket " << bucketSize;
+
+	return ss.str();
+}
+
+bool clTuning::operator==(const clTuning& other) const 
+{
+	return (groupSize == other.groupSize) && (scratchSize == other.scratchSize) && (bucketSize == other.bucketSize);
+}
+
+}
@@ -0,0 +1,95 @@
+// BEAM OpenCL Miner
+// Declarative description of the kernel pipelines
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_clPipeline_H 
+#define beamMiner_clPipeline_H 
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// One kernel argument. Buffers and constants are bound once when the device 
+// is set up, only header and nonce change from batch to batch
+struct clStageArg 
+{
+	enum Type 
+	{
+		buffer,		// shared buffer of the device, value is the index
+		counters,	// counter buffer of the slot
+		results,	// result buffer of the slot
+		header,		// block header of the current work (cl_ulong4)
+		nonce,		// nonce of the current batch (cl_ulong)
+		target,		// share target of the current work as big endian words (cl_uint8)
+		constant	// cl_uint constant, value is the constant
+	} type;
+	uint32_t value;
+};
+
+struct clStage 
+{
+	std::string kernel;
+	std::vector<clStageArg> args;
+	size_t globalSize;
+	size_t localSize;
+	bool flush;			// flush the queue after this stage 
+	bool tunable;			// work-group size follows clTuning::groupSize
+};
+
+// Kernel geometry, passed to the kernel as -D options
+struct clTuning 
+{
+	uint32_t groupSize = 256;
+	uint32_t scratchSize = 1216;
+	uint32_t bucketSize = 8672;
+
+	std::string buildOptions() const;
+	std::string toString() const;
+	bool operator==(const clTuning&) const;
+};
+
+// A solver variant: build options, the buffers it needs and its stages in order.
+// The first stage clears the counters, the last one writes the results.
+struct clPipeline 
+{
+	std::string name;
+	std::string buildOptions;
+	std::vector<uint64_t> bufferSizes;
+	uint64_t countersSize;
+	uint64_t abortOffset;		// Byte offset of the abort word in the counters
+	uint64_t telemetryOffset;	// Byte offset of the overflow counters of -DTELEMETRY builds
+	uint64_t resultsSize;
+	std::vector<clStage> stages;
+
+	// Largest bucket the buffers can hold, 0 if the bucket size is fixed
+	uint32_t maxBucketSize;
+	clTuning tuning;
+
+	uint64_t memoryNeeded(uint32_t) const;
+	uint64_t localMemoryNeeded() const;
+	clPipeline tuned(const clTuning&) const;
+	clPipeline fitted(uint64_t) const;
+
+	// True if the kernels can run with the tuning on a device with the given limits
+	bool accepts(const clTuning&, uint64_t, uint64_t) const;
+
+	// Appends the stage that drops solutions below the share target on the device
+	clPipeline filtered() const;
+
+	// Candidates for one step of the auto tuner, each varies one parameter of the given tuning
+	std::vector<clTuning> tuningCandidates(const clTuning&, uint32_t) const;
+	static const uint32_t tuningSteps = 3;
+};
+
+// All known variants, the preferred ones first
+const std::vector<clPipeline>& clPipelines();
+const clPipeline* findPipeline(const std::string&);
+
+}
+
+#endif
@@ -0,0 +1,136 @@
+// BEAM OpenCL Miner
+// Disk cache for compiled OpenCL programs
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "clProgramCache.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <vector>
+#include <filesystem>
+
+namespace beamMiner 
+{
+
+// 64 bit FNV-1a, only used to get short file names and a fingerprint of the kernel source
+static uint64_t fnv1a(const std::string& data) 
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : data) 
+	{
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static std::string toHex(uint64_t value) 
+{
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << value;
+
+	return ss.str();
+}
+
+clProgramCache::clProgramCache(std::string directoryIn) 
+{
+	directory = directoryIn;
+}
+
+bool clProgramCache::isEnabled() 
+{
+	return !directory.empty();
+}
+
+std::string clProgramCache::createKey(cl::Device& device, const std::string& source, const std::string& options) 
+{
+	std::string name = device.getInfo<CL_DEVICE_NAME>();
+	std::string driver = device.getInfo<CL_DRIVER_VERSION>();
+	std::string version = device.getInfo<CL_DEVICE_VERSION>();
+
+	// The strings reported by some drivers contain trailing zeros
+	std::string key = name.c_str();
+	key += "|" + std::string(driver.c_str());
+	key += "|" + std::string(version.c_str());
+	key += "|" + toHex(fnv1a(source));
+	key += "|" + options;
+
+	return key;
+}
+
+std::string clProgramCache::fileName(const std::string& key) 
+{
+	return (std::filesystem::path(directory) / ("beam-" + toHex(fnv1a(key)) + ".bin")).string();
+}
+
+// The file holds the full key, a zero byte and the program binary
+bool clProgramCache::load(const std::string& key, cl::Context& context, cl::Device& device, cl::Program& program) 
+{
+	if (!isEnabled()) return false;
+
+	std::ifstream file(fileName(key), std::ios::binary);
+	if (!file) return false;
+
+	std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if ((content.size() <= key.size() + 1) || (key.compare(0, key.size(), content.data(), key.size()) != 0) || (content[key.size()] != 0)) 
+	{
+		return false;
+	}
+
+	const char* binary = content.data() + key.size() + 1;
+	size_t binarySize = content.size() - key.size() - 1;
+
+	std::vector<cl::Device> devices(1, device);
+	cl::Program::Binaries binaries(1, std::make_pair((const void*) binary, binarySize));
+	std::vector<cl_int> binaryStatus;
+	cl_int err;
+
+	cl::Program cached(context, devices, binaries, &binaryStatus, &err);
+	if ((err != CL_SUCCESS) || (binaryStatus[0] != CL_SUCCESS)) return false;
+
+	// Binaries still need to be built, but this is only a link step
+	if (cached.build(devices, "") != CL_SUCCESS) return false;
+
+	program = cached;
+
+	return true;
+}
+
+void clProgramCache::store(const std::string& key, cl::Program& program) 
+{
+	if (!isEnabled()) return;
+
+	size_t binarySize = 0;
+	if (clGetProgramInfo(program(), CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, NULL) != CL_SUCCESS) return;
+	if (binarySize == 0) return;
+
+	std::vector<unsigned char> binary(binarySize);
+	unsigned char* binaryPtr = binary.data();
+	if (clGetProgramInfo(program(), CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binaryPtr, NULL) != CL_SUCCESS) return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+
+	// Write to a temporary file first, so a concurrent start never sees a half written binary
+	std::string target = fileName(key);
+	std::string temporary = target + ".tmp" + toHex((uintptr_t) program());
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file) return;
+
+		file.write(key.data(), key.size());
+		file.put(0);
+		file.write((const char*) binary.data(), binary.size());
+		if (!file) return;
+	}
+
+	std::filesystem::rename(temporary, target, ec);
+	if (ec) std::filesystem::remove(temporary, ec);
+}
+
+}
@@ -0,0 +1,39 @@
+// BEAM OpenCL Miner
+// Disk cache for compiled OpenCL programs
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_clProgramCache_H 
+#define beamMiner_clProgramCache_H 
+
+#include <CL/cl.hpp>
+#include <string>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Stores the binaries of successfully built programs. A binary is only reused if device name,
+// driver version, kernel source and build options are identical to the ones it was built with.
+class clProgramCache 
+{
+	private:
+	std::string directory;
+
+	std::string fileName(const std::string&);
+
+	public:
+	clProgramCache(std::string);
+
+	bool isEnabled();
+
+	static std::string createKey(cl::Device&, const std::string&, const std::string&);
+
+	bool load(const std::string&, cl::Context&, cl::Device&, cl::Program&);
+	void store(const std::string&, cl::Program&);
+};
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+// BEAM OpenCL Miner
+// Instruction set detection of the host CPU
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "cpuFeatures.h"
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define beamMiner_X86
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define beamMiner_X86
+#endif
+
+namespace beamMiner 
+{
+
+#ifdef beamMiner_X86
+static void cpuid(uint32_t leaf, uint32_t subLeaf, uint32_t regs[4]) 
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuidex(info, leaf, subLeaf);
+	for (int i = 0; i < 4; i++) regs[i] = info[i];
+#else
+	__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the operating system saves on context switches
+static uint64_t xgetbv() 
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return ((uint64_t) edx << 32) | eax;
+#endif
+}
+#endif
+
+static cpuFeatures detect() 
+{
+	cpuFeatures features;
+
+#ifdef beamMiner_X86
+	uint32_t regs[4];
+	cpuid(0, 0, regs);
+	if (regs[0] < 7) return features;
+
+	cpuid(1, 0, regs);
+	bool osxsave = (regs[2] >> 27) & 1;
+	bool avx = (regs[2] >> 28) & 1;
+	uint64_t xcr0 = (osxsave) ? xgetbv() : 0;
+
+	cpuid(7, 0, regs);
+	features.avx2 = avx && ((xcr0 & 0x6) == 0x6) && ((regs[1] >> 5) & 1);
+	features.avx512 = features.avx2 && ((xcr0 & 0xE0) == 0xE0) && ((regs[1] >> 16) & 1);
+	features.sha = (regs[1] >> 29) & 1;
+#endif
+
+	return features;
+}
+
+const cpuFeatures& hostCpuFeatures() 
+{
+	static const cpuFeatures features = detect();
+
+	return features;
+}
+
+}
@@ -0,0 +1,26 @@
+// BEAM OpenCL Miner
+// Instruction set detection of the host CPU
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_cpuFeatures_H 
+#define beamMiner_cpuFeatures_H 
+
+namespace beamMiner 
+{
+
+// Extensions the CPU has and the operating system saves the registers of
+struct cpuFeatures 
+{
+	bool avx2 = false;
+	bool avx512 = false;
+	bool sha = false;
+};
+
+// Detected once on the first call
+const cpuFeatures& hostCpuFeatures();
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+// BEAM OpenCL Miner
+// Duty cycle scheduler
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "dutyCycle.h"
+
+#include <algorithm>
+
+namespace beamMiner 
+{
+
+dutyCycle::dutyCycle(uint32_t targetIn, uint32_t slots) 
+{
+	target = std::min<uint32_t>(std::max<uint32_t>(targetIn, 1), 100);
+
+	queuedAt.assign(slots, clock::now());
+	lastDone = clock::now();
+	nextRelease = clock::now();
+}
+
+uint32_t dutyCycle::getTarget()
+{
+	return target;
+}
+
+double dutyCycle::getBusyTime()
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	return busyTime;
+}
+
+// Batches are released in a fixed rhythm of busyTime * 100 / target, so the
+// device idles for the remaining share of time no matter how many slots are queued
+std::chrono::microseconds dutyCycle::idleTime() 
+{
+	if (target >= 100) return std::chrono::microseconds(0);
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	clock::time_point now = clock::now();
+	clock::time_point release = std::max(now, nextRelease);
+
+	nextRelease = release + std::chrono::microseconds((int64_t) (busyTime * 100.0 / target));
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(release - now);
+}
+
+void dutyCycle::batchQueued(uint32_t slot) 
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	queuedAt[slot] = clock::now();
+}
+
+void dutyCycle::batchCompleted(uint32_t slot) 
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	clock::time_point now = clock::now();
+
+	// The device could only start the batch once it was queued and the one before was done
+	clock::time_point start = std::max(queuedAt[slot], lastDone);
+	double measured = (double) std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+	lastDone = now;
+
+	busyTime = (busyTime == 0) ? measured : (0.9 * busyTime + 0.1 * measured);
+}
+
+}
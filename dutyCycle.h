@@ -0,0 +1,52 @@
+// BEAM OpenCL Miner
+// Duty cycle scheduler
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_dutyCycle_H 
+#define beamMiner_dutyCycle_H 
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Keeps a device busy for a target percentage of the time. The device time of 
+// every batch is measured from the moment the device could start it until it 
+// completed, the idle time needed to reach the target is derived from that.
+class dutyCycle 
+{
+	private:
+	typedef std::chrono::steady_clock clock;
+
+	uint32_t target;
+
+	// Moving average of the device time of one batch in microseconds
+	double busyTime = 0;
+
+	std::vector<clock::time_point> queuedAt;
+	clock::time_point lastDone;
+	clock::time_point nextRelease;
+
+	std::mutex lock;
+
+	public:
+	dutyCycle(uint32_t, uint32_t);
+
+	uint32_t getTarget();
+	double getBusyTime();
+
+	// Time to wait before the next batch may be queued, zero at 100%
+	std::chrono::microseconds idleTime();
+
+	void batchQueued(uint32_t);
+	void batchCompleted(uint32_t);
+};
+
+}
+
+#endif
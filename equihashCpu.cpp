@@ -0,0 +1,335 @@
+// BEAM OpenCL Miner
+// Native Equihash 150/5 solver for the host CPU
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "equihashCpu.h"
+#include "blake2b.h"
+
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+namespace beamMiner 
+{
+
+static const uint32_t hashesPerTask = 1024;
+static const uint32_t bucketsPerTask = 16;
+
+// Reverses the bit order in each byte, the kernels xor the elements in this order
+static inline uint32_t swapBitOrder(uint32_t input)
+{
+	input = ((input & 0x0F0F0F0F) << 4) | ((input & 0xF0F0F0F0) >> 4);
+	input = ((input & 0x33333333) << 2) | ((input & 0xCCCCCCCC) >> 2);
+	return ((input & 0x55555555) << 1) | ((input & 0xAAAAAAAA) >> 1);
+}
+
+void blockElementWords(const uint64_t* hashes, uint32_t words[16][16])
+{
+	uint32_t sum[15] = {0};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t k = 0; k < 15; k++)
+		{
+			sum[k] += (uint32_t) (hashes[8*i + k/2] >> (32 * (k & 1)));
+			words[i][k] = swapBitOrder(sum[k]);
+		}
+		words[i][15] = 0;
+	}
+}
+
+equihashCpu::equihashCpu(uint32_t threadsIn)
+{
+	threads = std::max<uint32_t>(threadsIn, 1);
+
+	size_t slots = (size_t) buckets * bucketSize;
+	hashesA.reset(new uint32_t[slots * 5]);
+	hashesB.reset(new uint32_t[slots * 4]);
+	for (uint32_t r = 0; r < 5; r++) trees[r].reset(new uint32_t[slots]);
+
+	for (uint32_t c = 0; c < 2; c++) counters[c].reset(new std::atomic<uint32_t>[buckets]);
+}
+
+void equihashCpu::runThreads(const std::function<void(uint32_t)>& func)
+{
+	std::vector<std::thread> pool;
+	for (uint32_t t = 1; t < threads; t++) pool.push_back(std::thread(func, t));
+
+	func(0);
+	for (std::thread& thread : pool) thread.join();
+}
+
+// Hashes all indices and sorts the elements into the buckets by their lowest 13 bits,
+// the other 137 bits are kept in 5 words
+void equihashCpu::round0(const uint64_t* header, uint64_t nonce, const std::function<bool()>& stale)
+{
+	for (uint32_t b = 0; b < buckets; b++) counters[0][b] = 0;
+
+	std::atomic<uint32_t> nextTask(0);
+	runThreads([&](uint32_t)
+	{
+		std::vector<uint64_t> hashes(8 * hashesPerTask);
+		uint32_t words[16][16];
+
+		while (!aborted)
+		{
+			uint32_t first = nextTask.fetch_add(hashesPerTask);
+			if (first >= hashCount) break;
+			if (stale())
+			{
+				aborted = true;
+				break;
+			}
+
+			uint32_t count = std::min(hashesPerTask, hashCount - first);
+			beamHashes(header, nonce, first, count, hashes.data());
+
+			for (uint32_t block = 0; block < count; block += 16)
+			{
+				blockElementWords(&hashes[8 * block], words);
+
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					for (uint32_t j = 0; j < 3; j++)
+					{
+						uint32_t word = (152 * j) >> 5;
+						uint32_t shift = (152 * j) & 31;
+
+						uint32_t element[6];
+						for (uint32_t w = 0; w < 5; w++)
+						{
+							element[w] = (shift == 0) ? words[i][word + w] : (words[i][word + w] >> shift) | (words[i][word + w + 1] << (32 - shift));
+						}
+						element[4] &= 0x3FFFFF;
+						element[5] = 0;
+
+						uint32_t bucket = element[0] & 0x1FFF;
+						uint32_t pos = counters[0][bucket].fetch_add(1, std::memory_order_relaxed);
+						if (pos >= bucketSize) continue;
+
+						size_t slot = (size_t) bucket * bucketSize + pos;
+						for (uint32_t w = 0; w < 5; w++) hashesA[5*slot + w] = (element[w] >> 13) | (element[w + 1] << 19);
+						trees[0][slot] = 3 * (first + block + i) + j;
+					}
+				}
+			}
+		}
+	});
+}
+
+// Collides the elements of round r-1 on their next 12 bits and sorts the 25 bit shorter
+// results into the buckets of round r
+template <uint32_t inWords, uint32_t outWords>
+void equihashCpu::round(uint32_t r, const std::function<bool()>& stale)
+{
+	if (aborted) return;
+
+	const uint32_t* input = (r & 1) ? hashesA.get() : hashesB.get();
+	uint32_t* output = (r & 1) ? hashesB.get() : hashesA.get();
+	std::atomic<uint32_t>* inCounter = counters[(r - 1) & 1].get();
+	std::atomic<uint32_t>* outCounter = counters[r & 1].get();
+	uint32_t* inTree = trees[r - 1].get();
+	uint32_t* outTree = trees[r].get();
+
+	for (uint32_t b = 0; b < buckets; b++) outCounter[b] = 0;
+
+	std::atomic<uint32_t> nextTask(0);
+	runThreads([&](uint32_t)
+	{
+		std::vector<uint32_t> binStart(bins + 1);
+		std::vector<uint32_t> binNext(bins);
+		std::vector<uint16_t> order(bucketSize);
+		std::vector<uint32_t> sortedTree(bucketSize);
+
+		while (!aborted)
+		{
+			uint32_t firstBucket = nextTask.fetch_add(bucketsPerTask);
+			if (firstBucket >= buckets) break;
+			if (stale())
+			{
+				aborted = true;
+				break;
+			}
+
+			for (uint32_t b = firstBucket; b < firstBucket + bucketsPerTask; b++)
+			{
+				uint32_t count = std::min<uint32_t>(inCounter[b], bucketSize);
+				const uint32_t* in = &input[(size_t) b * bucketSize * inWords];
+
+				// Counting sort of the bucket by the 12 bits to collide on
+				std::fill(binStart.begin(), binStart.end(), 0);
+				for (uint32_t i = 0; i < count; i++) binStart[(in[i * inWords] & 0xFFF) + 1]++;
+				for (uint32_t k = 1; k <= bins; k++) binStart[k] += binStart[k - 1];
+
+				std::copy(binStart.begin(), binStart.end() - 1, binNext.begin());
+				for (uint32_t i = 0; i < count; i++) order[binNext[in[i * inWords] & 0xFFF]++] = i;
+
+				// The trees of the previous round follow the sorted order, so pairs get short references
+				uint32_t* tree = &inTree[(size_t) b * bucketSize];
+				for (uint32_t i = 0; i < count; i++) sortedTree[i] = tree[order[i]];
+				std::copy(sortedTree.begin(), sortedTree.begin() + count, tree);
+
+				for (uint32_t k = 0; k < bins; k++)
+				{
+					uint32_t end = binStart[k + 1];
+					for (uint32_t i = binStart[k]; i + 1 < end; i++)
+					{
+						const uint32_t* a = &in[order[i] * inWords];
+						for (uint32_t j = i + 1; (j < end) && (j - i < 32); j++)
+						{
+							const uint32_t* c = &in[order[j] * inWords];
+
+							uint32_t x[inWords + 1];
+							for (uint32_t w = 0; w < inWords; w++) x[w] = a[w] ^ c[w];
+							x[inWords] = 0;
+
+							uint32_t bucket = (x[0] >> 12) & 0x1FFF;
+							uint32_t out[outWords];
+							bool zero = (bucket == 0);
+							for (uint32_t w = 0; w < outWords; w++)
+							{
+								out[w] = (x[w] >> 25) | (x[w + 1] << 7);
+								zero = zero && (out[w] == 0);
+							}
+
+							// Equal elements only lead to solutions with duplicate indices
+							if (zero) continue;
+
+							uint32_t pos = outCounter[bucket].fetch_add(1, std::memory_order_relaxed);
+							if (pos >= bucketSize) continue;
+
+							size_t slot = (size_t) bucket * bucketSize + pos;
+							for (uint32_t w = 0; w < outWords; w++) output[outWords * slot + w] = out[w];
+							outTree[slot] = b | (i << 13) | ((j - i) << 27);
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+// The remaining 37 bits of both elements of a pair have to be equal
+void equihashCpu::lastRound(const std::function<bool()>& stale)
+{
+	if (aborted) return;
+
+	const uint32_t* input = hashesA.get();
+	std::atomic<uint32_t>* inCounter = counters[0].get();
+	uint32_t* inTree = trees[4].get();
+
+	std::atomic<uint32_t> nextTask(0);
+	runThreads([&](uint32_t)
+	{
+		std::vector<uint32_t> binStart(bins + 1);
+		std::vector<uint32_t> binNext(bins);
+		std::vector<uint16_t> order(bucketSize);
+		std::vector<uint32_t> sortedTree(bucketSize);
+		std::vector<uint32_t> found;
+
+		while (!aborted)
+		{
+			uint32_t firstBucket = nextTask.fetch_add(bucketsPerTask);
+			if (firstBucket >= buckets) break;
+			if (stale())
+			{
+				aborted = true;
+				break;
+			}
+
+			for (uint32_t b = firstBucket; b < firstBucket + bucketsPerTask; b++)
+			{
+				uint32_t count = std::min<uint32_t>(inCounter[b], bucketSize);
+				const uint32_t* in = &input[(size_t) b * bucketSize * 2];
+
+				std::fill(binStart.begin(), binStart.end(), 0);
+				for (uint32_t i = 0; i < count; i++) binStart[(in[2 * i] & 0xFFF) + 1]++;
+				for (uint32_t k = 1; k <= bins; k++) binStart[k] += binStart[k - 1];
+
+				std::copy(binStart.begin(), binStart.end() - 1, binNext.begin());
+				for (uint32_t i = 0; i < count; i++) order[binNext[in[2 * i] & 0xFFF]++] = i;
+
+				uint32_t* tree = &inTree[(size_t) b * bucketSize];
+				for (uint32_t i = 0; i < count; i++) sortedTree[i] = tree[order[i]];
+				std::copy(sortedTree.begin(), sortedTree.begin() + count, tree);
+
+				for (uint32_t k = 0; k < bins; k++)
+				{
+					uint32_t end = binStart[k + 1];
+					for (uint32_t i = binStart[k]; i + 1 < end; i++)
+					{
+						const uint32_t* a = &in[2 * order[i]];
+						for (uint32_t j = i + 1; (j < end) && (j - i < 32); j++)
+						{
+							const uint32_t* c = &in[2 * order[j]];
+							if ((a[0] == c[0]) && (a[1] == c[1])) found.push_back(b | (i << 13) | ((j - i) << 27));
+						}
+					}
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(candidateMutex);
+		candidates.insert(candidates.end(), found.begin(), found.end());
+	});
+}
+
+// Collects the indices below a pair of the given round, the half with the smaller first index comes first
+void equihashCpu::expand(uint32_t r, uint32_t ref, std::vector<uint32_t>& indices)
+{
+	size_t slot = (size_t) (ref & 0x1FFF) * bucketSize + ((ref >> 13) & 0x3FFF);
+	uint32_t distance = ref >> 27;
+
+	std::vector<uint32_t> left, right;
+	if (r == 0)
+	{
+		left.push_back(trees[0][slot]);
+		right.push_back(trees[0][slot + distance]);
+	}
+	else
+	{
+		expand(r - 1, trees[r][slot], left);
+		expand(r - 1, trees[r][slot + distance], right);
+	}
+
+	if (left[0] > right[0]) std::swap(left, right);
+
+	indices.insert(indices.end(), left.begin(), left.end());
+	indices.insert(indices.end(), right.begin(), right.end());
+}
+
+bool equihashCpu::solve(const uint8_t* header, uint64_t nonce, const std::function<bool()>& stale, std::vector< std::vector<uint32_t> >& solutions)
+{
+	uint64_t header64[4];
+	memcpy(header64, header, 32);
+
+	aborted = false;
+	candidates.clear();
+
+	round0(header64, nonce, stale);
+	round<5, 4>(1, stale);
+	round<4, 3>(2, stale);
+	round<3, 2>(3, stale);
+	round<2, 2>(4, stale);
+	lastRound(stale);
+
+	if (aborted) return false;
+
+	for (uint32_t candidate : candidates)
+	{
+		std::vector<uint32_t> indices;
+		expand(4, candidate, indices);
+
+		// Different pairs of a round may share elements, each index may only appear once
+		std::vector<uint32_t> sorted = indices;
+		std::sort(sorted.begin(), sorted.end());
+		if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) continue;
+
+		solutions.push_back(indices);
+	}
+
+	return true;
+}
+
+}
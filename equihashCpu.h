@@ -0,0 +1,72 @@
+// BEAM OpenCL Miner
+// Native Equihash 150/5 solver for the host CPU
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_equihashCpu_H 
+#define beamMiner_equihashCpu_H 
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Turns the hashes of a block of 16 indices into the words the elements are cut from,
+// exactly like round0 of the kernels: each word is the sum of the words of all hashes from
+// the start of the block up to the hash, with the bit order of every byte reversed.
+// Element j of hash i are the 150 bits starting at bit 152*j of words[i].
+void blockElementWords(const uint64_t* hashes, uint32_t words[16][16]);
+
+// Solves one nonce with the same element layout as the kernels. The elements of a round are
+// sorted into 2^13 buckets by their next 13 bits, every bucket is then sorted by the following
+// 12 bits in a small local table that stays in the cache, equal entries form the pairs of
+// the next round. All rounds run on a pool of threads, each one taking whole buckets.
+class equihashCpu
+{
+	public:
+	static const uint32_t hashCount = 22369536;	// Blake2b calls per nonce, 3 elements each
+	static const uint32_t buckets = 8192;
+	static const uint32_t bucketSize = 8704;
+	static const uint32_t bins = 4096;
+
+	private:
+	uint32_t threads;
+
+	// Remaining bits of the elements, rounds 0, 2 and 4 write A, rounds 1 and 3 write B
+	std::unique_ptr<uint32_t[]> hashesA;
+	std::unique_ptr<uint32_t[]> hashesB;
+
+	// Per round the index of each element (round 0) or the pair in the previous round it
+	// came from, packed as bucket | position << 13 | distance << 27
+	std::unique_ptr<uint32_t[]> trees[5];
+
+	std::unique_ptr< std::atomic<uint32_t>[] > counters[2];
+
+	// Final collisions of the last solve, packed like the trees
+	std::vector<uint32_t> candidates;
+	std::mutex candidateMutex;
+
+	std::atomic<bool> aborted;
+
+	void runThreads(const std::function<void(uint32_t)>&);
+	void round0(const uint64_t*, uint64_t, const std::function<bool()>&);
+	template <uint32_t inWords, uint32_t outWords> void round(uint32_t, const std::function<bool()>&);
+	void lastRound(const std::function<bool()>&);
+	void expand(uint32_t, uint32_t, std::vector<uint32_t>&);
+
+	public:
+	equihashCpu(uint32_t);
+
+	// Appends the solutions of one nonce, false if stale() asked to stop early
+	bool solve(const uint8_t*, uint64_t, const std::function<bool()>&, std::vector< std::vector<uint32_t> >&);
+};
+
+}
+
+#endif
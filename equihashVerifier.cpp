@@ -0,0 +1,98 @@
+// BEAM OpenCL Miner
+// Host side check of Equihash 150/5 solutions before they are submitted
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "equihashVerifier.h"
+#include "equihashCpu.h"
+#include "blake2b.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace beamMiner 
+{
+
+static const uint32_t solutionSize = 32;
+static const uint32_t elementWords = 5;
+
+// Cuts element j out of the words of its hash, 150 bits starting at bit 152*j
+static void elementOf(const uint32_t* words, uint32_t j, uint32_t* element)
+{
+	uint32_t word = (152 * j) >> 5;
+	uint32_t shift = (152 * j) & 31;
+
+	for (uint32_t w = 0; w < elementWords; w++)
+	{
+		element[w] = (shift == 0) ? words[word + w] : (words[word + w] >> shift) | (words[word + w + 1] << (32 - shift));
+	}
+	element[4] &= 0x3FFFFF;
+}
+
+static bool lowBitsZero(const uint32_t* element, uint32_t bits)
+{
+	for (uint32_t w = 0; (w < elementWords) && (bits > 0); w++)
+	{
+		uint32_t mask = (bits >= 32) ? 0xFFFFFFFF : ((1u << bits) - 1);
+		if ((element[w] & mask) != 0) return false;
+		bits -= std::min<uint32_t>(bits, 32);
+	}
+	return true;
+}
+
+bool verifySolution(const uint8_t* header, uint64_t nonce, const std::vector<uint32_t>& indices)
+{
+	if (indices.size() != solutionSize) return false;
+
+	std::vector<uint32_t> sorted = indices;
+	std::sort(sorted.begin(), sorted.end());
+	if (sorted.back() >= 3 * equihashCpu::hashCount) return false;
+	if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) return false;
+
+	// The left subtree of every pair starts with the smaller index
+	for (uint32_t size = 1; size < solutionSize; size *= 2)
+	{
+		for (uint32_t i = 0; i < solutionSize; i += 2 * size)
+		{
+			if (indices[i] >= indices[i + size]) return false;
+		}
+	}
+
+	uint64_t header64[4];
+	memcpy(header64, header, 32);
+
+	// An element depends on all hashes of its block of 16 before it, so whole blocks are hashed
+	uint32_t elements[solutionSize][elementWords];
+	uint64_t hashes[8 * 16];
+	uint32_t words[16][16];
+	for (uint32_t i = 0; i < solutionSize; i++)
+	{
+		uint32_t hashIndex = indices[i] / 3;
+		uint32_t blockStart = hashIndex & ~15u;
+
+		beamHashes(header64, nonce, blockStart, 16, hashes);
+		blockElementWords(hashes, words);
+		elementOf(words[hashIndex - blockStart], indices[i] % 3, elements[i]);
+	}
+
+	// Round r collides the next 25 bits, in the last round all 150 bits have to cancel
+	for (uint32_t r = 1; r <= 5; r++)
+	{
+		uint32_t size = 1u << r;
+		for (uint32_t i = 0; i < solutionSize; i += size)
+		{
+			uint32_t x[elementWords] = {0};
+			for (uint32_t k = i; k < i + size; k++)
+			{
+				for (uint32_t w = 0; w < elementWords; w++) x[w] ^= elements[k][w];
+			}
+
+			if (!lowBitsZero(x, (r == 5) ? 150 : 25 * r)) return false;
+		}
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,23 @@
+// BEAM OpenCL Miner
+// Host side check of Equihash 150/5 solutions before they are submitted
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_equihashVerifier_H 
+#define beamMiner_equihashVerifier_H 
+
+#include <vector>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Recomputes the 32 elements of a solution with the batched Blake2b and checks that the
+// indices are distinct and in range, that every subtree starts with the smaller index and
+// that the elements of each subtree of round r xor to zero on their lowest 25*r bits.
+bool verifySolution(const uint8_t* header, uint64_t nonce, const std::vector<uint32_t>& indices);
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+// BEAM OpenCL Miner
+// Table driven hex encoding and decoding
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "hexCodec.h"
+
+#include <cstring>
+
+namespace beamMiner 
+{
+
+// Both digits of every byte, so each byte is one lookup
+struct hexTables 
+{
+	char pairs[256][2];
+	int8_t values[256];
+
+	hexTables() 
+	{
+		const char* digits = "0123456789abcdef";
+		for (uint32_t i = 0; i < 256; i++) 
+		{
+			pairs[i][0] = digits[i >> 4];
+			pairs[i][1] = digits[i & 15];
+			values[i] = -1;
+		}
+
+		for (uint32_t i = 0; i < 10; i++) values['0' + i] = i;
+		for (uint32_t i = 0; i < 6; i++) 
+		{
+			values['a' + i] = 10 + i;
+			values['A' + i] = 10 + i;
+		}
+	}
+};
+
+static const hexTables tables;
+
+void encodeHex(const uint8_t* data, size_t size, char* out) 
+{
+	for (size_t i = 0; i < size; i++) memcpy(&out[2*i], tables.pairs[data[i]], 2);
+}
+
+bool isHex(const char* text, size_t size) 
+{
+	if (size & 1) return false;
+
+	int8_t invalid = 0;
+	for (size_t i = 0; i < size; i++) invalid |= tables.values[(uint8_t) text[i]];
+
+	return (invalid >= 0);
+}
+
+bool decodeHex(const char* text, size_t size, std::vector<uint8_t>& out) 
+{
+	if (!isHex(text, size)) return false;
+
+	out.resize(size / 2);
+	for (size_t i = 0; i < size / 2; i++) 
+	{
+		out[i] = (tables.values[(uint8_t) text[2*i]] << 4) | tables.values[(uint8_t) text[2*i + 1]];
+	}
+
+	return true;
+}
+
+}
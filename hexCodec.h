@@ -0,0 +1,28 @@
+// BEAM OpenCL Miner
+// Table driven hex encoding and decoding
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_hexCodec_H 
+#define beamMiner_hexCodec_H 
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Writes 2*size lower case digits to out, no terminating zero
+void encodeHex(const uint8_t* data, size_t size, char* out);
+
+// True for an even number of hex digits in either case
+bool isHex(const char* text, size_t size);
+
+// Replaces the content of out, false and out unchanged if the text is no valid hex
+bool decodeHex(const char* text, size_t size, std::vector<uint8_t>& out);
+
+}
+
+#endif
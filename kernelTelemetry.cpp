@@ -0,0 +1,61 @@
+// BEAM OpenCL Miner
+// Overflow statistics of the kernel rounds
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "kernelTelemetry.h"
+
+#include <sstream>
+#include <iomanip>
+
+namespace beamMiner 
+{
+
+static const char* kindNames[kernelTelemetry::kinds] = {"bucket", "scratch", "search", "candidates"};
+
+kernelTelemetry::kernelTelemetry() 
+{
+	totals.assign(counters, 0);
+}
+
+// Counters of one batch as read from the device
+void kernelTelemetry::add(const uint32_t* values) 
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (uint32_t i = 0; i < counters; i++) totals[i] += values[i];
+	batches++;
+}
+
+std::string kernelTelemetry::report() 
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(1);
+
+	for (uint32_t r = 0; r < rounds; r++) 
+	{
+		bool first = true;
+		for (uint32_t k = 0; k < kinds; k++) 
+		{
+			uint64_t total = totals[r * kinds + k];
+			if ((batches == 0) || (total == 0)) continue;
+
+			if (first) ss << "round" << r;
+			ss << " " << kindNames[k] << " " << (double) total / batches;
+			first = false;
+		}
+		if (!first) ss << " ";
+	}
+
+	if (ss.tellp() == 0) ss << "none";
+
+	totals.assign(counters, 0);
+	batches = 0;
+
+	return ss.str();
+}
+
+}
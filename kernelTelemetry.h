@@ -0,0 +1,45 @@
+// BEAM OpenCL Miner
+// Overflow statistics of the kernel rounds
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_kernelTelemetry_H 
+#define beamMiner_kernelTelemetry_H 
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Sums up what the rounds of kernels built with -DTELEMETRY dropped. Each round 
+// has four counters in the counter buffer: elements beyond the bucket size, elements 
+// beyond the scratch size, collision searches cut off and round 5 candidates beyond 256.
+class kernelTelemetry 
+{
+	public:
+	enum { bucket, scratch, search, candidates, kinds };
+	static const uint32_t rounds = 6;
+	static const uint32_t counters = rounds * kinds;
+
+	private:
+	std::vector<uint64_t> totals;
+	uint64_t batches = 0;
+
+	std::mutex lock;
+
+	public:
+	kernelTelemetry();
+
+	void add(const uint32_t*);
+
+	// Average losses per batch since the last report, then starts over
+	std::string report();
+};
+
+}
+
+#endif
@@ -3,16 +3,61 @@
 // Copyright 2018 The Beam Team	
 // Copyright 2018 Wilke Trei
 
+// Tuning parameters, the host may override them with -D options. WG_SIZE is the work-group
+// size of round 1 to 5 (64, 128 or 256), SCRATCH_SIZE the elements per group in local memory
+// (below 4095) and BUCKET_SIZE the bucket capacity of the 4G kernel (8192 to 8704) or the 6G
+// kernel (8192 to 10240). The 6G kernel has larger defaults, it drops fewer elements.
+#ifdef MEM6G
+#ifndef SCRATCH_SIZE
+#define SCRATCH_SIZE 1536
+#endif
+
+#ifndef BUCKET_SIZE
+#define BUCKET_SIZE 9216
+#endif
+#endif
+
+#ifndef WG_SIZE
+#define WG_SIZE 256
+#endif
+
+#ifndef SCRATCH_SIZE
+#define SCRATCH_SIZE 1216
+#endif
+
+#ifndef BUCKET_SIZE
+#define BUCKET_SIZE 8672
+#endif
+
+// Number of collision search steps per thread
+#define iterLimit ((40 * 256 / WG_SIZE) * SCRATCH_SIZE / 1216)
+
 #ifdef MEM3G
 #define bucketSize 8496
 #define r1Mask 0xFFF
 #else
-#define bucketSize 8672
+#define bucketSize BUCKET_SIZE
 #define r1Mask 0x1FFF
 #endif
 
 #define tmp56 8496
 
+// Set by the host when the job of a batch got replaced, the work groups of all remaining rounds return at once
+#define abortIdx 49152
+
+// With -DTELEMETRY every round counts what it drops, four counters per round behind the abort word:
+// elements beyond the bucket size, elements beyond the scratch size, collision searches cut off 
+// by iterLimit and, in round 5, candidates beyond the 256 the combine step takes
+#define telemetryIdx 49156
+
+#ifdef TELEMETRY
+#define telemetryCount(cond, round, kind) if (cond) atomic_inc(&counters[telemetryIdx + 4*(round) + (kind)])
+#define telemetryAdd(cond, value, round, kind) if (cond) atomic_add(&counters[telemetryIdx + 4*(round) + (kind)], (value))
+#else
+#define telemetryCount(cond, round, kind)
+#define telemetryAdd(cond, value, round, kind)
+#endif
+
 __kernel void clearCounter (
 		__global uint4 * counters,
 		__global uint4 * res) {
@@ -22,7 +67,12 @@ __kernel void clearCounter (
 
 	if (gId == 0) {
 		res[0] = (uint4) 0; 
+		counters[abortIdx >> 2] = (uint4) 0;
 	}
+
+#ifdef TELEMETRY
+	if (gId < 6) counters[(telemetryIdx >> 2) + gId] = (uint4) 0;
+#endif
 }
 
 /*
@@ -151,6 +201,12 @@ __kernel void round0(
 
 	uint tId = get_global_id(0);
 
+	__local uint aborted[1];
+	if (get_local_id(0) == 0) aborted[0] = counters[abortIdx];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (aborted[0] != 0) return;						// Stale batch, the whole group reads the same local word
+
        	ulong v[16];
 	ulong m[16];
 	m[0] = blockHeader.s0;
@@ -358,6 +414,7 @@ __kernel void round0(
 		output = shr_5(output,13);
 		
 		
+		telemetryCount(pos >= bucketSize, 0, 0);
 		if (pos < bucketSize) {
 			outputLo[bucket*bucketSize+pos] = output.lo;
 			outputHi[bucket*bucketSize+pos] = output.s45;
@@ -367,6 +424,7 @@ __kernel void round0(
 	pos = atomic_inc(&counters[bucket]);
 	output = shr_5(output,13);
 		
+	telemetryCount(pos >= bucketSize, 0, 0);
 	if (pos < bucketSize) {
 		outputLo[bucket*bucketSize+pos] = output.lo;
 		outputHi[bucket*bucketSize+pos] = output.s45;
@@ -391,6 +449,7 @@ __kernel void round0(
 		bucket &= 0xFFF;
 		output = shr_5(output,13);
 		
+		telemetryCount(pos >= bucketSize, 0, 0);
 		if (pos < bucketSize) {
 			
 			outputLo[bucket*bucketSize+pos] = output.lo;
@@ -401,6 +460,7 @@ __kernel void round0(
 	pos = atomic_inc(&counters[bucket]);
 	output = shr_5(output,13);
 		
+	telemetryCount(pos >= bucketSize, 0, 0);
 	if (pos < bucketSize) {
 		outputLo[bucket*bucketSize+pos] = output.lo;
 		outputHi[bucket*bucketSize+pos] = output.s45;
@@ -425,6 +485,7 @@ __kernel void round0(
 		output = shr_5(output,13);
 		
 		
+		telemetryCount(pos >= bucketSize, 0, 0);
 		if (pos < bucketSize) {
 			outputLo[bucket*bucketSize+pos] = output.lo;
 			outputHi[bucket*bucketSize+pos] = output.s45;
@@ -434,6 +495,7 @@ __kernel void round0(
 	pos = atomic_inc(&counters[bucket]);
 	output = shr_5(output,13);
 		
+	telemetryCount(pos >= bucketSize, 0, 0);
 	if (pos < bucketSize) {
 		outputLo[bucket*bucketSize+pos] = output.lo;
 		outputHi[bucket*bucketSize+pos] = output.s45;
@@ -445,14 +507,14 @@ __kernel void round0(
 void masking6(uint4 input0, uint2 input1, __local uint* scratch, __local uint* tab , __local uint* cnt, uint mask) {
 	if ((input0.s0 & 0x7) == mask) {
 		uint pos = atomic_inc(&cnt[0]);
-		if (pos < 1216) {
+		if (pos < SCRATCH_SIZE) {
 			uint value  = atomic_xchg(&tab[(input0.s0 >> 3) & 0x1FF], pos); 
 			scratch[pos]      = input0.s0;	
-			scratch[1216+pos] = input0.s1;
-			scratch[2432+pos] = input0.s2;
-			scratch[3648+pos] = input0.s3;
-			scratch[4864+pos] = input1.s0 | (value << 16);	// Saving space in round 1
-			scratch[6080+pos] = input1.s1;
+			scratch[SCRATCH_SIZE+pos] = input0.s1;
+			scratch[2*SCRATCH_SIZE+pos] = input0.s2;
+			scratch[3*SCRATCH_SIZE+pos] = input0.s3;
+			scratch[4*SCRATCH_SIZE+pos] = input1.s0 | (value << 16);	// Saving space in round 1
+			scratch[5*SCRATCH_SIZE+pos] = input1.s1;
 		}
 	}
 }
@@ -461,20 +523,20 @@ void masking6(uint4 input0, uint2 input1, __local uint* scratch, __local uint* t
 void masking4(uint4 input0, uint id, __local uint* scratch, __local uint* tab , __local uint* cnt, uint mask) {
 	if ((input0.s0 & 0x7) == mask) {
 		uint pos = atomic_inc(&cnt[0]);
-		if (pos < 1216) {
+		if (pos < SCRATCH_SIZE) {
 			uint value  = atomic_xchg(&tab[(input0.s0 >> 3) & 0x1FF], pos); 
 			scratch[pos]      = input0.s0;	
-			scratch[1216+pos] = input0.s1;
-			scratch[2432+pos] = input0.s2;
-			scratch[3648+pos] = input0.s3;
-			scratch[4864+pos] = value; 					
-			scratch[6080+pos] = id;
+			scratch[SCRATCH_SIZE+pos] = input0.s1;
+			scratch[2*SCRATCH_SIZE+pos] = input0.s2;
+			scratch[3*SCRATCH_SIZE+pos] = input0.s3;
+			scratch[4*SCRATCH_SIZE+pos] = value; 					
+			scratch[5*SCRATCH_SIZE+pos] = id;
 		}
 	}
 }
 
 #ifdef MEM3G
-__kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Round 1
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1))) void round1 (				// Round 1
 		__global uint4 * input0,
 		__global uint4 * output0,
 		__global uint2 * output1,
@@ -489,7 +551,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Ro
 	grp |= (inGrp << 15); 
 
 #else
-__kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Round 1
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1))) void round1 (				// Round 1
 		__global uint4 * input0,
 		__global uint2 * input1,
 		__global uint4 * output0,
@@ -504,17 +566,17 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Ro
 	uint bucket = grp >> 3;
 	uint mask = (grp & 7);
 
-	__local uint scratch[7296];
+	__local uint scratch[6*SCRATCH_SIZE];
 	
 	__local uint * scratch0 = &scratch[0];
-	__local uint * scratch1 = &scratch[1216];
-	__local uint * scratch2 = &scratch[2432];
-	__local uint * scratch3 = &scratch[3648];
-	__local uint * scratch4 = &scratch[4864];
-	__local uint * scratch5 = &scratch[6080];
+	__local uint * scratch1 = &scratch[SCRATCH_SIZE];
+	__local uint * scratch2 = &scratch[2*SCRATCH_SIZE];
+	__local uint * scratch3 = &scratch[3*SCRATCH_SIZE];
+	__local uint * scratch4 = &scratch[4*SCRATCH_SIZE];
+	__local uint * scratch5 = &scratch[5*SCRATCH_SIZE];
 
 	__local uint tab[512];
-	__local uint iCNT[2];
+	__local uint iCNT[3];
 
 	__global uint * inCounter = &counters[0];
 	__global uint * outCounter = &counters[8192];
@@ -522,61 +584,26 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Ro
 	if (lId == 0) {
 		iCNT[1] = 0;
 		iCNT[0] = min(inCounter[bucket],(uint) bucketSize);
+		iCNT[2] = counters[abortIdx];
 	} 
 
-	tab[lId] = 0xFFF;
-	tab[lId+256] = 0xFFF;
+	for (uint i = lId; i < 512; i += WG_SIZE) tab[i] = 0xFFF;
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
+	if (iCNT[2] != 0) return;						// Stale batch, the whole group reads the same local word
+
 	uint ofs = (bucket & r1Mask)*bucketSize;	
 
-	masking6(input0[ofs+lId], input1[ofs+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+256+lId], input1[ofs+256+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+512+lId], input1[ofs+512+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+768+lId], input1[ofs+768+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking6(input0[ofs+1024+lId], input1[ofs+1024+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+1280+lId], input1[ofs+1280+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+1536+lId], input1[ofs+1536+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+1792+lId], input1[ofs+1792+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking6(input0[ofs+2048+lId], input1[ofs+2048+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+2304+lId], input1[ofs+2304+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+2560+lId], input1[ofs+2560+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+2816+lId], input1[ofs+2816+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking6(input0[ofs+3072+lId], input1[ofs+3072+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+3328+lId], input1[ofs+3328+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+3584+lId], input1[ofs+3584+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+3840+lId], input1[ofs+3840+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking6(input0[ofs+4096+lId], input1[ofs+4096+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+4352+lId], input1[ofs+4352+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+4608+lId], input1[ofs+4608+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+4864+lId], input1[ofs+4864+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking6(input0[ofs+5120+lId], input1[ofs+5120+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+5376+lId], input1[ofs+5376+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+5632+lId], input1[ofs+5632+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+5888+lId], input1[ofs+5888+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking6(input0[ofs+6144+lId], input1[ofs+6144+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+6400+lId], input1[ofs+6400+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+6656+lId], input1[ofs+6656+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	masking6(input0[ofs+6912+lId], input1[ofs+6912+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking6(input0[ofs+7168+lId], input1[ofs+7168+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7424) < iCNT[0]) masking6(input0[ofs+7424+lId], input1[ofs+7424+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7680) < iCNT[0]) masking6(input0[ofs+7680+lId], input1[ofs+7680+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7936) < iCNT[0]) masking6(input0[ofs+7936+lId], input1[ofs+7936+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-
-	if ((lId + 8192) < iCNT[0]) masking6(input0[ofs+8192+lId], input1[ofs+8192+lId], &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 8448) < iCNT[0]) masking6(input0[ofs+8448+lId], input1[ofs+8448+lId], &scratch[0], &tab[0], &iCNT[1], mask);
+	#pragma unroll
+	for (uint i = 0; i < bucketSize; i += WG_SIZE) {
+		if ((i < 7424) || ((lId + i) < iCNT[0])) masking6(input0[ofs+i+lId], input1[ofs+i+lId], &scratch[0], &tab[0], &iCNT[1], mask);
+	}
 		
 	barrier(CLK_LOCAL_MEM_FENCE);	
 
-	uint inLim = min(iCNT[1], (uint) 1216);
+	uint inLim = min(iCNT[1], (uint) SCRATCH_SIZE);
+	telemetryAdd(lId == 0, iCNT[1] - inLim, 1, 1);
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
@@ -589,7 +616,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Ro
 	uint8 outputEl;
 	
 	while (ownPos < inLim) {
-		uint addr = (othPos < inLim) ? othPos : ownPos+256;
+		uint addr = (othPos < inLim) ? othPos : ownPos+WG_SIZE;
 		uint elem = scratch4[addr];
 		
 		if (othPos < inLim) {
@@ -607,6 +634,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Ro
 			outputEl.s4 = scratch5[ownPos];
 			outputEl.s5 = scratch5[othPos];
 
+			telemetryCount(pos >= bucketSize, 1, 0);
 			if (pos < bucketSize) {
 				pos += buck*bucketSize;
 				output0[pos] = outputEl.lo;
@@ -615,18 +643,19 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round1 (				// Ro
 			
 		} else { 
 			own = elem;
-			ownPos += 256;
+			ownPos += WG_SIZE;
 		}
 
 		othPos = (elem >> 16);
-		ownPos = (cnt<40) ? ownPos : inLim;
+		telemetryCount((cnt >= iterLimit) && (ownPos < inLim), 1, 2);
+		ownPos = (cnt<iterLimit) ? ownPos : inLim;
 		cnt++;
 	} 
 
 }  
 
 
-__kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round2 (				// Round 2
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1))) void round2 (				// Round 2
 		__global uint4 * input0,
 		__global uint4 * output0,
 		__global uint * counters) {
@@ -636,17 +665,17 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round2 (				// Ro
 	uint bucket = grp >> 3;
 	uint mask = (grp & 7);
 
-	__local uint scratch[7296];
+	__local uint scratch[6*SCRATCH_SIZE];
 	
 	__local uint * scratch0 = &scratch[0];
-	__local uint * scratch1 = &scratch[1216];
-	__local uint * scratch2 = &scratch[2432];
-	__local uint * scratch3 = &scratch[3648];
-	__local uint * scratch4 = &scratch[4864];
-	__local uint * scratch5 = &scratch[6080];
+	__local uint * scratch1 = &scratch[SCRATCH_SIZE];
+	__local uint * scratch2 = &scratch[2*SCRATCH_SIZE];
+	__local uint * scratch3 = &scratch[3*SCRATCH_SIZE];
+	__local uint * scratch4 = &scratch[4*SCRATCH_SIZE];
+	__local uint * scratch5 = &scratch[5*SCRATCH_SIZE];
 
 	__local uint tab[512];
-	__local uint iCNT[2];
+	__local uint iCNT[3];
 
 	__global uint * inCounter = &counters[8192];
 	__global uint * outCounter = &counters[16384];
@@ -654,61 +683,26 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round2 (				// Ro
 	if (lId == 0) {
 		iCNT[1] = 0;
 		iCNT[0] = min(inCounter[bucket],(uint) bucketSize);
+		iCNT[2] = counters[abortIdx];
 	} 
 
-	tab[lId] = 0xFFF;
-	tab[lId+256] = 0xFFF;
+	for (uint i = lId; i < 512; i += WG_SIZE) tab[i] = 0xFFF;
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
+	if (iCNT[2] != 0) return;						// Stale batch, the whole group reads the same local word
+
 	uint ofs = bucket*bucketSize;	
 
-	masking4(input0[ofs+lId], lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+256+lId], 256+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+512+lId], 512+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+768+lId], 768+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+1024+lId], 1024+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1280+lId], 1280+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1536+lId], 1536+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1792+lId], 1792+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+2048+lId], 2048+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2304+lId], 2304+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2560+lId], 2560+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2816+lId], 2816+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+3072+lId], 3072+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3328+lId], 3328+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3584+lId], 3584+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3840+lId], 3840+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+4096+lId], 4096+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4352+lId], 4352+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4608+lId], 4608+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4864+lId], 4864+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+5120+lId], 5120+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5376+lId], 5376+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5632+lId], 5632+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5888+lId], 5888+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+6144+lId], 6144+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6400+lId], 6400+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6656+lId], 6656+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6912+lId], 6912+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+7168+lId], 7168+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+7424+lId], 7424+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7680) < iCNT[0]) masking4(input0[ofs+7680+lId], 7680+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7936) < iCNT[0]) masking4(input0[ofs+7936+lId], 7936+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	if ((lId + 8192) < iCNT[0]) masking4(input0[ofs+8192+lId], 8192+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 8448) < iCNT[0]) masking4(input0[ofs+8448+lId], 8448+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	#pragma unroll
+	for (uint i = 0; i < bucketSize; i += WG_SIZE) {
+		if ((i < 7680) || ((lId + i) < iCNT[0])) masking4(input0[ofs+i+lId], i+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	}
 		
 	barrier(CLK_LOCAL_MEM_FENCE);	
 
-	uint inLim = min(iCNT[1], (uint) 1216);
+	uint inLim = min(iCNT[1], (uint) SCRATCH_SIZE);
+	telemetryAdd(lId == 0, iCNT[1] - inLim, 2, 1);
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
@@ -721,7 +715,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round2 (				// Ro
 	uint8 outputEl;
 	
 	while (ownPos < inLim) {
-		uint addr = (othPos < inLim) ? othPos : ownPos+256;
+		uint addr = (othPos < inLim) ? othPos : ownPos+WG_SIZE;
 		uint elem = scratch4[addr];
 		
 		if (othPos < inLim) {
@@ -752,6 +746,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round2 (				// Ro
 
 				outputEl.s2 |= (bucket >> 4) << 23; 
 
+				telemetryCount(pos >= bucketSize, 2, 0);
 				if (pos < bucketSize) {
 					pos += buck*bucketSize;
 					output0[pos] = outputEl.lo;
@@ -759,17 +754,18 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round2 (				// Ro
 			}
 		} else { 
 			own = elem;
-			ownPos += 256;
+			ownPos += WG_SIZE;
 		}
 
 		othPos = elem;
-		ownPos = (cnt<40) ? ownPos : inLim;
+		telemetryCount((cnt >= iterLimit) && (ownPos < inLim), 2, 2);
+		ownPos = (cnt<iterLimit) ? ownPos : inLim;
 		cnt++;
 	} 
 }
 
 
-__kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round3 (				// Round 3
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1))) void round3 (				// Round 3
 		__global uint4 * input0,
 		__global uint4 * output0,
 		__global uint * counters) {
@@ -779,17 +775,17 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round3 (				// Ro
 	uint bucket = grp >> 3;
 	uint mask = (grp & 7);
 
-	__local uint scratch[7296];
+	__local uint scratch[6*SCRATCH_SIZE];
 	
 	__local uint * scratch0 = &scratch[0];
-	__local uint * scratch1 = &scratch[1216];
-	__local uint * scratch2 = &scratch[2432];
-	__local uint * scratch3 = &scratch[3648];
-	__local uint * scratch4 = &scratch[4864];
-	__local uint * scratch5 = &scratch[6080];
+	__local uint * scratch1 = &scratch[SCRATCH_SIZE];
+	__local uint * scratch2 = &scratch[2*SCRATCH_SIZE];
+	__local uint * scratch3 = &scratch[3*SCRATCH_SIZE];
+	__local uint * scratch4 = &scratch[4*SCRATCH_SIZE];
+	__local uint * scratch5 = &scratch[5*SCRATCH_SIZE];
 
 	__local uint tab[512];
-	__local uint iCNT[2];
+	__local uint iCNT[3];
 
 	__global uint * inCounter = &counters[16384];
 	__global uint * outCounter = &counters[24576];
@@ -797,61 +793,26 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round3 (				// Ro
 	if (lId == 0) {
 		iCNT[1] = 0;
 		iCNT[0] = min(inCounter[bucket],(uint) bucketSize);
+		iCNT[2] = counters[abortIdx];
 	} 
 
-	tab[lId] = 0xFFF;
-	tab[lId+256] = 0xFFF;
+	for (uint i = lId; i < 512; i += WG_SIZE) tab[i] = 0xFFF;
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
+	if (iCNT[2] != 0) return;						// Stale batch, the whole group reads the same local word
+
 	uint ofs = bucket*bucketSize;	
 
-	masking4(input0[ofs+lId], ofs+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+256+lId], ofs+256+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+512+lId], ofs+512+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+768+lId], ofs+768+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+1024+lId], ofs+1024+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1280+lId], ofs+1280+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1536+lId], ofs+1536+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1792+lId], ofs+1792+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+2048+lId], ofs+2048+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2304+lId], ofs+2304+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2560+lId], ofs+2560+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2816+lId], ofs+2816+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+3072+lId], ofs+3072+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3328+lId], ofs+3328+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3584+lId], ofs+3584+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3840+lId], ofs+3840+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+4096+lId], ofs+4096+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4352+lId], ofs+4352+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4608+lId], ofs+4608+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4864+lId], ofs+4864+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+5120+lId], ofs+5120+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5376+lId], ofs+5376+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5632+lId], ofs+5632+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5888+lId], ofs+5888+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+6144+lId], ofs+6144+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6400+lId], ofs+6400+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6656+lId], ofs+6656+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6912+lId], ofs+6912+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+7168+lId], ofs+7168+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+7424+lId], ofs+7424+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7680) < iCNT[0]) masking4(input0[ofs+7680+lId], ofs+7680+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7936) < iCNT[0]) masking4(input0[ofs+7936+lId], ofs+7936+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	if ((lId + 8192) < iCNT[0]) masking4(input0[ofs+8192+lId], ofs+8192+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 8448) < iCNT[0]) masking4(input0[ofs+8448+lId], ofs+8448+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	#pragma unroll
+	for (uint i = 0; i < bucketSize; i += WG_SIZE) {
+		if ((i < 7680) || ((lId + i) < iCNT[0])) masking4(input0[ofs+i+lId], ofs+i+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	}
 		
 	barrier(CLK_LOCAL_MEM_FENCE);	
 
-	uint inLim = min(iCNT[1], (uint) 1216);
+	uint inLim = min(iCNT[1], (uint) SCRATCH_SIZE);
+	telemetryAdd(lId == 0, iCNT[1] - inLim, 3, 1);
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
@@ -864,7 +825,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round3 (				// Ro
 	uint8 outputEl;
 	
 	while (ownPos < inLim) {
-		uint addr = (othPos < inLim) ? othPos : ownPos+256;
+		uint addr = (othPos < inLim) ? othPos : ownPos+WG_SIZE;
 		uint elem = scratch4[addr];
 		
 		if (othPos < inLim) {
@@ -888,6 +849,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round3 (				// Ro
 				outputEl.s2 = scratch5[ownPos];
 				outputEl.s3 = scratch5[othPos];
 
+				telemetryCount(pos >= bucketSize, 3, 0);
 				if (pos < bucketSize) {
 					pos += buck*bucketSize;
 					output0[pos] = outputEl.lo;
@@ -895,17 +857,18 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round3 (				// Ro
 			}
 		} else { 
 			own = elem;
-			ownPos += 256;
+			ownPos += WG_SIZE;
 		}
 
 		othPos = elem;
-		ownPos = (cnt<40) ? ownPos : inLim;
+		telemetryCount((cnt >= iterLimit) && (ownPos < inLim), 3, 2);
+		ownPos = (cnt<iterLimit) ? ownPos : inLim;
 		cnt++;
 	} 
 }
 
 
-__kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round4 (				// Round 4
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1))) void round4 (				// Round 4
 		__global uint4 * input0,
 		__global uint4 * output0,
 		__global uint * counters) {
@@ -915,17 +878,17 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round4 (				// Ro
 	uint bucket = grp >> 3;
 	uint mask = (grp & 7);
 
-	__local uint scratch[7296];
+	__local uint scratch[6*SCRATCH_SIZE];
 	
 	__local uint * scratch0 = &scratch[0];
-	__local uint * scratch1 = &scratch[1216];
-	__local uint * scratch2 = &scratch[2432];
-	__local uint * scratch3 = &scratch[3648];
-	__local uint * scratch4 = &scratch[4864];
-	__local uint * scratch5 = &scratch[6080];
+	__local uint * scratch1 = &scratch[SCRATCH_SIZE];
+	__local uint * scratch2 = &scratch[2*SCRATCH_SIZE];
+	__local uint * scratch3 = &scratch[3*SCRATCH_SIZE];
+	__local uint * scratch4 = &scratch[4*SCRATCH_SIZE];
+	__local uint * scratch5 = &scratch[5*SCRATCH_SIZE];
 
 	__local uint tab[512];
-	__local uint iCNT[2];
+	__local uint iCNT[3];
 
 	__global uint * inCounter = &counters[24576];
 	__global uint * outCounter = &counters[32768];
@@ -933,61 +896,26 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round4 (				// Ro
 	if (lId == 0) {
 		iCNT[1] = 0;
 		iCNT[0] = min(inCounter[bucket],(uint) bucketSize);
+		iCNT[2] = counters[abortIdx];
 	} 
 
-	tab[lId] = 0xFFF;
-	tab[lId+256] = 0xFFF;
+	for (uint i = lId; i < 512; i += WG_SIZE) tab[i] = 0xFFF;
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
+	if (iCNT[2] != 0) return;						// Stale batch, the whole group reads the same local word
+
 	uint ofs = bucket*bucketSize;	
 
-	masking4(input0[ofs+lId], ofs+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+256+lId], ofs+256+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+512+lId], ofs+512+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+768+lId], ofs+768+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+1024+lId], ofs+1024+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1280+lId], ofs+1280+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1536+lId], ofs+1536+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1792+lId], ofs+1792+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+2048+lId], ofs+2048+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2304+lId], ofs+2304+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2560+lId], ofs+2560+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2816+lId], ofs+2816+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+3072+lId], ofs+3072+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3328+lId], ofs+3328+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3584+lId], ofs+3584+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3840+lId], ofs+3840+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+4096+lId], ofs+4096+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4352+lId], ofs+4352+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4608+lId], ofs+4608+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4864+lId], ofs+4864+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+5120+lId], ofs+5120+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5376+lId], ofs+5376+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5632+lId], ofs+5632+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5888+lId], ofs+5888+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+6144+lId], ofs+6144+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6400+lId], ofs+6400+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6656+lId], ofs+6656+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6912+lId], ofs+6912+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+7168+lId], ofs+7168+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7424) < iCNT[0]) masking4(input0[ofs+7424+lId], ofs+7424+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7680) < iCNT[0]) masking4(input0[ofs+7680+lId], ofs+7680+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7936) < iCNT[0]) masking4(input0[ofs+7936+lId], ofs+7936+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	if ((lId + 8192) < iCNT[0]) masking4(input0[ofs+8192+lId], ofs+8192+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 8448) < iCNT[0]) masking4(input0[ofs+8448+lId], ofs+8448+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	#pragma unroll
+	for (uint i = 0; i < bucketSize; i += WG_SIZE) {
+		if ((i < 7424) || ((lId + i) < iCNT[0])) masking4(input0[ofs+i+lId], ofs+i+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	}
 		
 	barrier(CLK_LOCAL_MEM_FENCE);	
 
-	uint inLim = min(iCNT[1], (uint) 1216);
+	uint inLim = min(iCNT[1], (uint) SCRATCH_SIZE);
+	telemetryAdd(lId == 0, iCNT[1] - inLim, 4, 1);
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
@@ -1000,7 +928,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round4 (				// Ro
 	uint8 outputEl;
 	
 	while (ownPos < inLim) {
-		uint addr = (othPos < inLim) ? othPos : ownPos+256;
+		uint addr = (othPos < inLim) ? othPos : ownPos+WG_SIZE;
 		uint elem = scratch4[addr];
 		
 		if (othPos < inLim) {
@@ -1024,6 +952,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round4 (				// Ro
 				outputEl.s2 = scratch5[ownPos]; 
 				outputEl.s3 = scratch5[othPos]; 
 
+				telemetryCount(pos >= bucketSize, 4, 0);
 				if (pos < bucketSize) {
 					pos += buck*bucketSize;
 					output0[pos] = outputEl.lo;
@@ -1031,17 +960,18 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round4 (				// Ro
 			}
 		} else { 
 			own = elem;
-			ownPos += 256;
+			ownPos += WG_SIZE;
 		}
 
 		othPos = elem;
-		ownPos = (cnt<40) ? ownPos : inLim;
+		telemetryCount((cnt >= iterLimit) && (ownPos < inLim), 4, 2);
+		ownPos = (cnt<iterLimit) ? ownPos : inLim;
 		cnt++;
 	} 
 }
 
 
-__kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round5 (				// Round 5
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1))) void round5 (				// Round 5
 		__global uint4 * input0,
 		__global uint4 * output0,
 		__global uint * counters) {
@@ -1051,17 +981,17 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round5 (				// Ro
 	uint bucket = grp >> 3;
 	uint mask = (grp & 7);
 
-	__local uint scratch[7296];
+	__local uint scratch[6*SCRATCH_SIZE];
 	
 	__local uint * scratch0 = &scratch[0];
-	__local uint * scratch1 = &scratch[1216];
-	__local uint * scratch2 = &scratch[2432];
-	__local uint * scratch3 = &scratch[3648];
-	__local uint * scratch4 = &scratch[4864];
-	__local uint * scratch5 = &scratch[6080];
+	__local uint * scratch1 = &scratch[SCRATCH_SIZE];
+	__local uint * scratch2 = &scratch[2*SCRATCH_SIZE];
+	__local uint * scratch3 = &scratch[3*SCRATCH_SIZE];
+	__local uint * scratch4 = &scratch[4*SCRATCH_SIZE];
+	__local uint * scratch5 = &scratch[5*SCRATCH_SIZE];
 
 	__local uint tab[512];
-	__local uint iCNT[2];
+	__local uint iCNT[3];
 
 	__global uint * inCounter = &counters[32768];
 	__global uint * outCounter = &counters[40960];
@@ -1069,61 +999,26 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round5 (				// Ro
 	if (lId == 0) {
 		iCNT[1] = 0;
 		iCNT[0] = min(inCounter[bucket],(uint) bucketSize);
+		iCNT[2] = counters[abortIdx];
 	} 
 
-	tab[lId] = 0xFFF;
-	tab[lId+256] = 0xFFF;
+	for (uint i = lId; i < 512; i += WG_SIZE) tab[i] = 0xFFF;
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
+	if (iCNT[2] != 0) return;						// Stale batch, the whole group reads the same local word
+
 	uint ofs = bucket*bucketSize;	
 
-	masking4(input0[ofs+lId], ofs+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+256+lId], ofs+256+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+512+lId], ofs+512+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+768+lId], ofs+768+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+1024+lId], ofs+1024+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1280+lId], ofs+1280+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1536+lId], ofs+1536+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+1792+lId], ofs+1792+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+2048+lId], ofs+2048+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2304+lId], ofs+2304+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2560+lId], ofs+2560+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+2816+lId], ofs+2816+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+3072+lId], ofs+3072+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3328+lId], ofs+3328+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3584+lId], ofs+3584+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+3840+lId], ofs+3840+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+4096+lId], ofs+4096+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4352+lId], ofs+4352+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4608+lId], ofs+4608+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+4864+lId], ofs+4864+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+5120+lId], ofs+5120+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5376+lId], ofs+5376+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5632+lId], ofs+5632+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+5888+lId], ofs+5888+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+6144+lId], ofs+6144+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6400+lId], ofs+6400+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6656+lId], ofs+6656+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+6912+lId], ofs+6912+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	masking4(input0[ofs+7168+lId], ofs+7168+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	masking4(input0[ofs+7424+lId], ofs+7424+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7680) < iCNT[0]) masking4(input0[ofs+7680+lId], ofs+7680+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 7936) < iCNT[0]) masking4(input0[ofs+7936+lId], ofs+7936+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-
-	if ((lId + 8192) < iCNT[0]) masking4(input0[ofs+8192+lId], ofs+8192+lId, &scratch[0], &tab[0], &iCNT[1], mask);
-	if ((lId + 8448) < iCNT[0]) masking4(input0[ofs+8448+lId], ofs+8448+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	#pragma unroll
+	for (uint i = 0; i < bucketSize; i += WG_SIZE) {
+		if ((i < 7680) || ((lId + i) < iCNT[0])) masking4(input0[ofs+i+lId], ofs+i+lId, &scratch[0], &tab[0], &iCNT[1], mask);
+	}
 		
 	barrier(CLK_LOCAL_MEM_FENCE);	
 
-	uint inLim = min(iCNT[1], (uint) 1216);
+	uint inLim = min(iCNT[1], (uint) SCRATCH_SIZE);
+	telemetryAdd(lId == 0, iCNT[1] - inLim, 5, 1);
 
 	barrier(CLK_LOCAL_MEM_FENCE);
 
@@ -1136,7 +1031,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round5 (				// Ro
 	uint2 outputEl;
 	
 	while (ownPos < inLim) {
-		uint addr = (othPos < inLim) ? othPos : ownPos+256;
+		uint addr = (othPos < inLim) ? othPos : ownPos+WG_SIZE;
 		uint elem = scratch4[addr];
 		
 		if (othPos < inLim) {
@@ -1155,6 +1050,7 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round5 (				// Ro
 
 				if (ok) {
 					pos = atomic_inc(&outCounter[0]);
+					telemetryCount(pos >= 256, 5, 3);
 					if (pos < 256) {
 						output0[pos] = index;
 					}
@@ -1162,11 +1058,12 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void round5 (				// Ro
 			}
 		} else { 
 			own = elem;
-			ownPos += 256;
+			ownPos += WG_SIZE;
 		}
 
 		othPos = elem;
-		ownPos = (cnt<40) ? ownPos : inLim;
+		telemetryCount((cnt >= iterLimit) && (ownPos < inLim), 5, 2);
+		ownPos = (cnt<iterLimit) ? ownPos : inLim;
 		cnt++;
 	} 
 }
@@ -1549,3 +1446,106 @@ __kernel __attribute__((reqd_work_group_size(256, 1, 1))) void move(
 	uint gId = get_global_id(0);
 	output[gId] = input[gId];
 }
+
+// Optional last stage: keeps only the solutions whose SHA-256 of the compressed form reaches the
+// share target, the host then only handles shares. results[1] keeps the number found before.
+
+__constant uint sha256K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define rotr(x, n) rotate((uint) (x), (uint) (32 - (n)))
+
+void sha256Block(uint * state, uint * w) {
+	uint a = state[0], b = state[1], c = state[2], d = state[3];
+	uint e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (uint t=0; t<64; t++) {
+		if (t >= 16) {
+			uint w15 = w[(t-15) & 15];
+			uint w2 = w[(t-2) & 15];
+			w[t & 15] += (rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3)) + w[(t-7) & 15] + (rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10));
+		}
+
+		uint t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + bitselect(g, f, e) + sha256K[t] + w[t & 15];
+		uint t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) | (c & (a | b)));
+
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+__kernel __attribute__((reqd_work_group_size(16, 1, 1))) void filterSolutions (
+		__global uint * results,
+		uint8 target) {
+
+	uint lId = get_local_id(0);
+
+	__local uint solutions[320];
+	__local uint passed[1];
+
+	uint count = min(results[0], (uint) 10);
+	for (uint i = lId; i < 32*count; i += 16) solutions[i] = results[4+i];
+	if (lId == 0) passed[0] = 0;
+
+	barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+	uint reached = 0;
+	if (lId < count) {
+		// Compressed form: 32 indices of 26 bits, most significant bit first, 104 bytes in two blocks
+		uint w[32];
+		ulong acc = 0;
+		uint accBits = 0;
+		uint pos = 0;
+		for (uint i=0; i<32; i++) {
+			acc = (acc << 26) | (solutions[32*lId + i] & 0x3FFFFFF);
+			accBits += 26;
+			if (accBits >= 32) {
+				accBits -= 32;
+				w[pos++] = (uint) (acc >> accBits);
+			}
+		}
+
+		w[26] = 0x80000000;
+		for (uint i=27; i<31; i++) w[i] = 0;
+		w[31] = 832;								// Message length in bits
+
+		uint state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+		sha256Block(state, &w[0]);
+		sha256Block(state, &w[16]);
+
+		// The hash is compared as a big endian number, a hash equal to the target reaches it
+		uint thresholds[8] = {target.s0, target.s1, target.s2, target.s3, target.s4, target.s5, target.s6, target.s7};
+		reached = 1;
+		for (uint i=0; i<8; i++) {
+			if (state[i] != thresholds[i]) {
+				reached = (state[i] < thresholds[i]) ? 1 : 0;
+				break;
+			}
+		}
+	}
+
+	uint addr = 0;
+	if (reached) addr = atomic_inc(&passed[0]);
+
+	barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+	if (reached) {
+		for (uint i=0; i<32; i++) results[4 + 32*addr + i] = solutions[32*lId + i];
+	}
+
+	if (lId == 0) {
+		results[1] = results[0];
+		results[0] = passed[0];
+	}
+}
@@ -49,9 +49,18 @@ uint32_t cmdParser(
 	vector<string> &minerCredentials, 
 	vector<int32_t> &devices, 
 	vector<int32_t> &intensities, 
+	uint32_t &queueDepth, 
+	bool &dualQueue, 
+	bool &profile, 
+	bool &telemetry, 
+	bool &gpuFilter, 
+	bool &autotune, 
 	bool &debug, 
-	bool &cpuMine, 
-	bool &force3G ) 
+	bool &openclCpu, 
+	uint32_t &cpuThreads, 
+	bool &force3G, 
+	string &kernelCacheDir, 
+	string &tuningFile ) 
 {
 	// exit if empy command line
 	if (args.size() < 2)
@@ -61,6 +70,7 @@ uint32_t cmdParser(
 
 	bool hostSet = false;
 	bool invalidIntensityValue = false;
+	bool invalidQueueDepth = false;
 	
 	for (size_t i = 1; i < args.size(); i++) 
 	{
@@ -116,7 +126,7 @@ uint32_t cmdParser(
 				for (int j = 0; j < tmp.size(); j++)
 				{
 					int32_t intensity = stoi(tmp[j]);
-					if (intensity < 0 || 999 < intensity) invalidIntensityValue = true;
+					if (intensity < 1 || 100 < intensity) invalidIntensityValue = true;
 					intensities.push_back(intensity);
 				}
 				i++;
@@ -128,6 +138,86 @@ uint32_t cmdParser(
 			}
 		}
 
+		if (args[i].compare("--queue-depth") == 0) 
+		{
+			if (i+1 < args.size()) 
+			{
+				int32_t depth = stoi(args[i+1]);
+				if (depth < 1 || 3 < depth) invalidQueueDepth = true;
+				queueDepth = depth;
+				i++;
+				continue;
+			}
+			else
+			{
+				return 0x8;
+			}
+		}
+
+		if (args[i].compare("--dual-queue")  == 0) 
+		{
+			dualQueue = true;
+			continue;
+		}
+
+		if (args[i].compare("--profile")  == 0) 
+		{
+			profile = true;
+			continue;
+		}
+
+		if (args[i].compare("--telemetry")  == 0) 
+		{
+			telemetry = true;
+			continue;
+		}
+
+		if (args[i].compare("--gpu-filter")  == 0) 
+		{
+			gpuFilter = true;
+			continue;
+		}
+
+		if (args[i].compare("--autotune")  == 0) 
+		{
+			autotune = true;
+			continue;
+		}
+
+		if (args[i].compare("--kernel-cache") == 0) 
+		{
+			if (i+1 < args.size()) 
+			{
+				kernelCacheDir = args[i+1];
+				i++;
+				continue;
+			}
+			else
+			{
+				return 0x8;
+			}
+		}
+
+		if (args[i].compare("--no-kernel-cache")  == 0) 
+		{
+			kernelCacheDir = "";
+			continue;
+		}
+
+		if (args[i].compare("--tuning-file") == 0) 
+		{
+			if (i+1 < args.size()) 
+			{
+				tuningFile = args[i+1];
+				i++;
+				continue;
+			}
+			else
+			{
+				return 0x8;
+			}
+		}
+
 		if (args[i].compare("--force3G")  == 0) 
 		{
 			force3G = true;
@@ -136,7 +226,34 @@ uint32_t cmdParser(
 
 		if (args[i].compare("--enable-cpu")  == 0) 
 		{
-			cpuMine = true;
+			if (cpuThreads == 0) cpuThreads = max<uint32_t>(thread::hardware_concurrency(), 1);
+			continue;
+		}
+
+		if (args[i].compare("--cpu-threads") == 0) 
+		{
+			if (i+1 < args.size()) 
+			{
+				try
+				{
+					cpuThreads = stoul(args[i+1]);
+				}
+				catch (...)
+				{
+					return 0x8;
+				}
+				i++;
+				continue;
+			}
+			else
+			{
+				return 0x8;
+			}
+		}
+
+		if (args[i].compare("--opencl-cpu")  == 0) 
+		{
+			openclCpu = true;
 			continue;
 		}
 
@@ -166,7 +283,8 @@ uint32_t cmdParser(
 	}
 	else if (0 == devices.size() && 0 == intensities.size())
 	{
-		intensities.push_back(999);
+		// zero leaves the choice to the tuning profile or the default of 100
+		intensities.push_back(0);
 	}
 	else if (0 == devices.size() && 1 == intensities.size())
 	{
@@ -177,6 +295,8 @@ uint32_t cmdParser(
 		result += 4;
 	}
 
+	if (invalidQueueDepth) result += 0x10;
+
 	return result;
 }
 
@@ -187,16 +307,25 @@ int main(int argc, char* argv[])
 	vector<string> ports;
 	vector<string> minerCredentials;
 	bool debug = false;
-	bool cpuMine = false;
+	bool openclCpu = false;
+	uint32_t cpuThreads = 0;
 	bool useTLS = true;
 	vector<int32_t> devices;
 	vector<int32_t> intensities;
+	uint32_t queueDepth = 0;
+	bool dualQueue = false;
+	bool profile = false;
+	bool telemetry = false;
+	bool gpuFilter = false;
+	bool autotune = false;
 	bool force3G = false;
+	string kernelCacheDir = "kernel-cache";
+	string tuningFile = "tuning-profiles.txt";
 
 	vector<beamMiner::clHost*> clHosts;
 	vector<beamMiner::beamStratum*> minerStratums;
 
-	uint32_t parsed = cmdParser(cmdLineArgs, hosts, ports, minerCredentials, devices, intensities, debug, cpuMine, force3G);
+	uint32_t parsed = cmdParser(cmdLineArgs, hosts, ports, minerCredentials, devices, intensities, queueDepth, dualQueue, profile, telemetry, gpuFilter, autotune, debug, openclCpu, cpuThreads, force3G, kernelCacheDir, tuningFile);
 
 	cout << ">>>>>>>>>>>>>>>>>>>>>>>>>>>>>" << endl;
 	cout << "   BEAM OpenCL miner         " << endl;
@@ -216,14 +345,30 @@ int main(int argc, char* argv[])
 		{
 			cout << "Error: Parameter --intensity invalid value" << endl;
 		}
+
+		if (parsed & 0x10)
+		{
+			cout << "Error: Parameter --queue-depth invalid value" << endl;
+		}
 		
 		cout << endl;
 		cout << "Parameters: " << endl;
 		cout << " --help / -h " << "\t\t\t\tShow this message" << endl;
 		cout << " --server <server>:<port>:<key> " << "\tThe BEAM stratum server, port, and API key (required)" << endl;
 		cout << " --devices <numbers> " << "\t\t\tA comma-separated list of devices that should be used for mining (default: all)" << endl; 
-		cout << " --intensity <intensity> " << "\t\tThe miner intensity(ies) (if more than one, comma-separated; takes values from 0 to 999; default: 999)" << endl;
-		cout << " --enable-cpu " << "\t\t\t\tEnable mining on OpenCL CPU devices" << endl;
+		cout << " --intensity <intensity> " << "\t\tTarget GPU utilization in percent (if more than one, comma-separated; takes values from 1 to 100; default: 100)" << endl;
+		cout << " --queue-depth <depth> " << "\t\tNumber of batches kept in flight on each device (takes values from 1 to 3; default: 2)" << endl;
+		cout << " --dual-queue " << "\t\t\t\tClear counters and read back results on a second queue per device" << endl;
+		cout << " --profile " << "\t\t\t\tPrint the device time of every kernel stage with the hashrate" << endl;
+		cout << " --telemetry " << "\t\t\t\tPrint the elements every kernel round drops because a bucket or scratch area is full" << endl;
+		cout << " --gpu-filter " << "\t\t\t\tCheck the share target on the device and only read back shares" << endl;
+		cout << " --autotune " << "\t\t\t\tBenchmark kernel work-group and bucket sizes on every device before mining" << endl;
+		cout << " --kernel-cache <dir> " << "\t\tDirectory for compiled kernel binaries (default: kernel-cache)" << endl;
+		cout << " --no-kernel-cache " << "\t\t\tAlways compile the kernels from source" << endl;
+		cout << " --tuning-file <file> " << "\t\tFile for the tuning profiles of --autotune, applied on later starts (default: tuning-profiles.txt)" << endl;
+		cout << " --enable-cpu " << "\t\t\t\tAlso mine with the native solver on the host CPU (needs about 4GB of RAM)" << endl;
+		cout << " --cpu-threads <threads> " << "\t\tThreads of the native CPU solver, enables it (default: all cores)" << endl;
+		cout << " --opencl-cpu " << "\t\t\t\tEnable mining on OpenCL CPU devices" << endl;
 		cout << " --force3G	" << "\t\t\tForce miner to use max 3GB for all installed GPUs" << endl;
 		cout << " --debug " << "\t\t\t\tPrint debugging info" << endl;
 		cout << " --version	" << "\t\t\tPrint the version number" << endl;
@@ -241,19 +386,63 @@ int main(int argc, char* argv[])
 	}
 	if (devices.empty())
 	{
-		cout << "Intensity: " << intensities[0] << endl;
+		if (0 == intensities[0])
+		{
+			cout << "Intensity: tuning profile or 100%" << endl;
+		}
+		else
+		{
+			cout << "Intensity: " << intensities[0] << "%" << endl;
+		}
 	}
 	else
 	{
 		for (size_t i = 0; i < devices.size(); i++)
 		{
 			int32_t intensity = (1 == intensities.size())?(intensities[0]):(intensities[i]);
-			cout << "Device|Intensity: " << devices[i] << "|" << intensity << endl;
+			cout << "Device|Intensity: " << devices[i] << "|" << intensity << "%" << endl;
 		}
 	}
-	if (cpuMine)
+	if (0 == queueDepth)
+	{
+		cout << "Queue depth: tuning profile or 2" << endl;
+	}
+	else
+	{
+		cout << "Queue depth: " << queueDepth << endl;
+	}
+	if (dualQueue)
+	{
+		cout << "Dual queue mode enabled" << endl;
+	}
+	if (profile)
+	{
+		cout << "Kernel profiling enabled" << endl;
+	}
+	if (telemetry)
+	{
+		cout << "Kernel telemetry enabled" << endl;
+	}
+	if (gpuFilter)
+	{
+		cout << "Share target filtering on the device enabled" << endl;
+	}
+	if (autotune)
+	{
+		cout << "Kernel auto tuning enabled" << endl;
+	}
+	if (kernelCacheDir.empty())
+	{
+		cout << "Kernel cache disabled" << endl;
+	}
+	cout << "Tuning profiles: " << tuningFile << endl;
+	if (cpuThreads > 0)
+	{
+		cout << "CPU mining enabled with " << cpuThreads << " threads" << endl;
+	}
+	if (openclCpu)
 	{
-		cout << "CPU mining enabled" << endl;
+		cout << "OpenCL CPU devices enabled" << endl;
 	}
 	if (force3G)
 	{
@@ -269,7 +458,7 @@ int main(int argc, char* argv[])
 		cout << "Setup OpenCL devices:" << endl;
 		cout << ">>>>>>>>>>>>>>>>>>>>>" << endl;
 		
-		beamMiner::clHost *clHost = new beamMiner::clHost(minerStratum, devices, intensities, cpuMine, force3G);
+		beamMiner::clHost *clHost = new beamMiner::clHost(minerStratum, devices, intensities, queueDepth, dualQueue, profile, telemetry, gpuFilter, autotune, openclCpu, cpuThreads, force3G, kernelCacheDir, tuningFile);
 
 		minerStratums.push_back(minerStratum);
 		clHosts.push_back(clHost);
@@ -0,0 +1,76 @@
+// BEAM OpenCL Miner
+// Lock free snapshot of a small value with one writer
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_seqlock_H 
+#define beamMiner_seqlock_H 
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace beamMiner 
+{
+
+// The value is kept in atomic words next to a sequence number that is odd while the writer
+// changes them. Readers copy the words and retry if the sequence was odd or moved meanwhile,
+// so they never block and never see half of an update. Only one thread may store.
+template <typename T>
+class seqlock 
+{
+	static_assert(std::is_trivially_copyable<T>::value, "seqlock needs a trivially copyable type");
+
+	private:
+	static const size_t words = (sizeof(T) + 7) / 8;
+
+	std::atomic<uint64_t> sequence;
+	std::atomic<uint64_t> data[words];
+
+	public:
+	seqlock(const T& value = T()) 
+	{
+		sequence = 0;
+		for (size_t i = 0; i < words; i++) data[i] = 0;
+		store(value);
+	}
+
+	void store(const T& value) 
+	{
+		uint64_t buffer[words] = {0};
+		memcpy(buffer, &value, sizeof(T));
+
+		uint64_t seq = sequence.load(std::memory_order_relaxed);
+		sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < words; i++) data[i].store(buffer[i], std::memory_order_relaxed);
+
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	T load() const 
+	{
+		uint64_t buffer[words];
+		uint64_t before, after;
+		do 
+		{
+			before = sequence.load(std::memory_order_acquire);
+			for (size_t i = 0; i < words; i++) buffer[i] = data[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		}
+		while ((before & 1) || (before != after));
+
+		T value;
+		memcpy(&value, buffer, sizeof(T));
+
+		return value;
+	}
+};
+
+}
+
+#endif
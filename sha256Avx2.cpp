@@ -0,0 +1,132 @@
+// BEAM OpenCL Miner
+// SHA-256 of eight messages side by side in AVX2 registers
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+// This file is built with AVX2 enabled, sha256Batch only calls it on CPUs that have it
+
+#include "sha256Batch.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace beamMiner 
+{
+
+#ifdef __AVX2__
+static const uint32_t lanes = 8;
+
+static inline __m256i ror(__m256i x, int n) 
+{
+	return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+static inline uint32_t loadBigEndian(const uint8_t* p) 
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+// Lane l of every register belongs to the block at blocks[l]
+static void compress(__m256i state[8], const uint8_t* const blocks[lanes]) 
+{
+	__m256i w[16];
+	for (uint32_t t = 0; t < 16; t++) 
+	{
+		w[t] = _mm256_setr_epi32(
+			loadBigEndian(blocks[0] + 4*t), loadBigEndian(blocks[1] + 4*t), loadBigEndian(blocks[2] + 4*t), loadBigEndian(blocks[3] + 4*t),
+			loadBigEndian(blocks[4] + 4*t), loadBigEndian(blocks[5] + 4*t), loadBigEndian(blocks[6] + 4*t), loadBigEndian(blocks[7] + 4*t));
+	}
+
+	__m256i a = state[0], b = state[1], c = state[2], d = state[3];
+	__m256i e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (uint32_t t = 0; t < 64; t++) 
+	{
+		if (t >= 16) 
+		{
+			__m256i w15 = w[(t - 15) & 15];
+			__m256i w2 = w[(t - 2) & 15];
+			__m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ror(w15, 7), ror(w15, 18)), _mm256_srli_epi32(w15, 3));
+			__m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ror(w2, 17), ror(w2, 19)), _mm256_srli_epi32(w2, 10));
+			w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+		}
+
+		__m256i sum1 = _mm256_xor_si256(_mm256_xor_si256(ror(e, 6), ror(e, 11)), ror(e, 25));
+		__m256i choose = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+		__m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sum1), _mm256_add_epi32(choose, _mm256_add_epi32(_mm256_set1_epi32(sha256K[t]), w[t & 15])));
+
+		__m256i sum0 = _mm256_xor_si256(_mm256_xor_si256(ror(a, 2), ror(a, 13)), ror(a, 22));
+		__m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+		__m256i t2 = _mm256_add_epi32(sum0, majority);
+
+		h = g; g = f; f = e;
+		e = _mm256_add_epi32(d, t1);
+		d = c; c = b; b = a;
+		a = _mm256_add_epi32(t1, t2);
+	}
+
+	state[0] = _mm256_add_epi32(state[0], a);
+	state[1] = _mm256_add_epi32(state[1], b);
+	state[2] = _mm256_add_epi32(state[2], c);
+	state[3] = _mm256_add_epi32(state[3], d);
+	state[4] = _mm256_add_epi32(state[4], e);
+	state[5] = _mm256_add_epi32(state[5], f);
+	state[6] = _mm256_add_epi32(state[6], g);
+	state[7] = _mm256_add_epi32(state[7], h);
+}
+#endif
+
+bool sha256BatchAvx2(const uint8_t* const* messages, size_t size, uint32_t count, uint8_t* out) 
+{
+#ifdef __AVX2__
+	uint8_t tails[lanes][128];
+
+	for (uint32_t first = 0; first < count; first += lanes) 
+	{
+		// A short last group repeats its last message in the unused lanes
+		const uint8_t* group[lanes];
+		for (uint32_t l = 0; l < lanes; l++) group[l] = messages[(first + l < count) ? first + l : count - 1];
+
+		__m256i state[8];
+		for (uint32_t i = 0; i < 8; i++) state[i] = _mm256_set1_epi32(sha256IV[i]);
+
+		const uint8_t* blocks[lanes];
+		for (size_t block = 0; block + 64 <= size; block += 64) 
+		{
+			for (uint32_t l = 0; l < lanes; l++) blocks[l] = group[l] + block;
+			compress(state, blocks);
+		}
+
+		uint32_t tailBlocks = 0;
+		for (uint32_t l = 0; l < lanes; l++) tailBlocks = sha256Tail(group[l], size, tails[l]);
+		for (uint32_t block = 0; block < tailBlocks; block++) 
+		{
+			for (uint32_t l = 0; l < lanes; l++) blocks[l] = tails[l] + 64*block;
+			compress(state, blocks);
+		}
+
+		uint32_t words[8][lanes];
+		for (uint32_t i = 0; i < 8; i++) _mm256_storeu_si256((__m256i*) words[i], state[i]);
+
+		for (uint32_t l = 0; (l < lanes) && (first + l < count); l++) 
+		{
+			uint8_t* digest = out + 32*(first + l);
+			for (uint32_t i = 0; i < 8; i++) 
+			{
+				digest[4*i] = (uint8_t) (words[i][l] >> 24);
+				digest[4*i + 1] = (uint8_t) (words[i][l] >> 16);
+				digest[4*i + 2] = (uint8_t) (words[i][l] >> 8);
+				digest[4*i + 3] = (uint8_t) words[i][l];
+			}
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+}
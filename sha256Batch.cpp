@@ -0,0 +1,45 @@
+// BEAM OpenCL Miner
+// SHA-256 of many equally long messages for the share target checks
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "sha256Batch.h"
+#include "cpuFeatures.h"
+
+#include "crypto/sha256.c"
+
+namespace beamMiner 
+{
+
+// The reference implementation, one message at a time
+void sha256BatchScalar(const uint8_t* const* messages, size_t size, uint32_t count, uint8_t* out) 
+{
+	for (uint32_t i = 0; i < count; i++) Sha256_Onestep(messages[i], size, out + 32*i);
+}
+
+typedef bool (*batchHashes)(const uint8_t* const*, size_t, uint32_t, uint8_t*);
+
+// Fastest implementation the CPU runs and the compiler built, NULL for the scalar code
+static batchHashes selectHashes() 
+{
+	static const uint8_t message[1] = {0};
+	const uint8_t* test[1] = {message};
+	uint8_t digest[32];
+
+	const cpuFeatures& features = hostCpuFeatures();
+	if (features.sha && sha256BatchShani(test, 1, 1, digest)) return sha256BatchShani;
+	if (features.avx2 && sha256BatchAvx2(test, 1, 1, digest)) return sha256BatchAvx2;
+
+	return NULL;
+}
+
+void sha256Batch(const uint8_t* const* messages, size_t size, uint32_t count, uint8_t* out) 
+{
+	static const batchHashes hashes = selectHashes();
+
+	if (hashes != NULL) hashes(messages, size, count, out);
+	else sha256BatchScalar(messages, size, count, out);
+}
+
+}
@@ -0,0 +1,64 @@
+// BEAM OpenCL Miner
+// SHA-256 of many equally long messages for the share target checks
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_sha256Batch_H 
+#define beamMiner_sha256Batch_H 
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace beamMiner 
+{
+
+static const uint32_t sha256K[64] = 
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256IV[8] = 
+{
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// The last one or two blocks of a message: its bytes after the last full block, 0x80, 
+// zeros and the length in bits. Returns the number of blocks written to tail.
+inline uint32_t sha256Tail(const uint8_t* message, size_t size, uint8_t tail[128]) 
+{
+	size_t full = size & ~(size_t) 63;
+	size_t rest = size - full;
+
+	memset(tail, 0, 128);
+	memcpy(tail, message + full, rest);
+	tail[rest] = 0x80;
+
+	uint32_t blocks = (rest + 9 > 64) ? 2 : 1;
+	uint64_t bits = (uint64_t) size * 8;
+	for (uint32_t i = 0; i < 8; i++) tail[64*blocks - 1 - i] = (uint8_t) (bits >> (8*i));
+
+	return blocks;
+}
+
+// Hashes count messages of size bytes each, the digest of message i goes to out + 32*i
+void sha256Batch(const uint8_t* const* messages, size_t size, uint32_t count, uint8_t* out);
+
+// The implementations behind sha256Batch. SHA-NI hashes one message after the other with 
+// the SHA extensions, AVX2 eight messages side by side. They return false if the compiler 
+// did not build them for the instruction set.
+void sha256BatchScalar(const uint8_t* const*, size_t, uint32_t, uint8_t*);
+bool sha256BatchShani(const uint8_t* const*, size_t, uint32_t, uint8_t*);
+bool sha256BatchAvx2(const uint8_t* const*, size_t, uint32_t, uint8_t*);
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+// BEAM OpenCL Miner
+// SHA-256 with the SHA extensions of x86 CPUs
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+// This file is built with SHA and SSE4.1 enabled, sha256Batch only calls it on CPUs that have them
+
+#include "sha256Batch.h"
+
+#if (defined(__SHA__) && defined(__SSE4_1__)) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#define beamMiner_SHANI
+#include <immintrin.h>
+#endif
+
+namespace beamMiner 
+{
+
+#ifdef beamMiner_SHANI
+// The state is kept as ABEF and CDGH, the order the round instructions expect
+static void compress(__m128i& abef, __m128i& cdgh, const uint8_t* block) 
+{
+	const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	__m128i abefSave = abef;
+	__m128i cdghSave = cdgh;
+
+	// Four message words per register, w[i & 3] holds the words of rounds 4i to 4i+3
+	__m128i w[4];
+	for (uint32_t i = 0; i < 16; i++) 
+	{
+		if (i < 4) 
+		{
+			w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (block + 16*i)), byteSwap);
+		}
+		else 
+		{
+			__m128i next = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+			next = _mm_add_epi32(next, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+			w[i & 3] = _mm_sha256msg2_epu32(next, w[(i + 3) & 3]);
+		}
+
+		__m128i message = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i*) &sha256K[4*i]));
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+		message = _mm_shuffle_epi32(message, 0x0E);
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, message);
+	}
+
+	abef = _mm_add_epi32(abef, abefSave);
+	cdgh = _mm_add_epi32(cdgh, cdghSave);
+}
+#endif
+
+bool sha256BatchShani(const uint8_t* const* messages, size_t size, uint32_t count, uint8_t* out) 
+{
+#ifdef beamMiner_SHANI
+	const __m128i wordSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	uint8_t tail[128];
+
+	for (uint32_t n = 0; n < count; n++) 
+	{
+		__m128i dcba = _mm_loadu_si128((const __m128i*) &sha256IV[0]);
+		__m128i hgfe = _mm_loadu_si128((const __m128i*) &sha256IV[4]);
+
+		__m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+		__m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+		__m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+		__m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+		const uint8_t* message = messages[n];
+		for (size_t block = 0; block + 64 <= size; block += 64) compress(abef, cdgh, message + block);
+
+		uint32_t tailBlocks = sha256Tail(message, size, tail);
+		for (uint32_t block = 0; block < tailBlocks; block++) compress(abef, cdgh, tail + 64*block);
+
+		// Back to the word order of the state and big endian bytes
+		__m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+		__m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+		dcba = _mm_blend_epi16(feba, dchg, 0xF0);
+		hgfe = _mm_alignr_epi8(dchg, feba, 8);
+
+		_mm_storeu_si128((__m128i*) (out + 32*n), _mm_shuffle_epi8(dcba, wordSwap));
+		_mm_storeu_si128((__m128i*) (out + 32*n + 16), _mm_shuffle_epi8(hgfe, wordSwap));
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+}
@@ -0,0 +1,76 @@
+// BEAM OpenCL Miner
+// Share target of a job as a 256 bit threshold
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "shareTarget.h"
+
+#include <cstring>
+
+namespace beamMiner 
+{
+
+shareTarget::shareTarget() 
+{
+	memset(threshold, 0, sizeof(threshold));
+	reachable = false;
+}
+
+shareTarget::shareTarget(const beam::Difficulty& diff) 
+{
+	memset(threshold, 0, sizeof(threshold));
+	reachable = (diff.m_Packed <= beam::Difficulty::s_Inf);
+	if (!reachable) return;
+
+	// The infinite difficulty stands for a D of 2^256 - 1, the only case that is no mantissa times a power of two
+	if (diff.m_Packed == beam::Difficulty::s_Inf) 
+	{
+		threshold[28] = 1;
+		return;
+	}
+
+	uint32_t order, mantissa;
+	diff.Unpack(order, mantissa);
+
+	// (2^280 - 1) / (mantissa * 2^order) rounds down to (2^(280 - order) - 1) / mantissa, 
+	// a number of 280 - order one bits divided by the mantissa in 32 bit big endian limbs
+	const uint32_t limbs = 9;
+	uint32_t ones = 280 - order;
+	uint32_t numerator[limbs];
+	for (uint32_t i = 0; i < limbs; i++) 
+	{
+		uint32_t bitsBelow = 32 * (limbs - 1 - i);
+		if (ones >= bitsBelow + 32) numerator[i] = 0xFFFFFFFF;
+		else if (ones > bitsBelow) numerator[i] = (1u << (ones - bitsBelow)) - 1;
+		else numerator[i] = 0;
+	}
+
+	uint64_t remainder = 0;
+	for (uint32_t i = 0; i < limbs; i++) 
+	{
+		uint64_t current = (remainder << 32) | numerator[i];
+		uint32_t quotient = (uint32_t) (current / mantissa);
+		remainder = current % mantissa;
+
+		// The quotient fits 256 bits as the mantissa is at least 2^24, limb 0 stays zero
+		if (i == 0) continue;
+		for (uint32_t b = 0; b < 4; b++) threshold[4*(i - 1) + b] = (uint8_t) (quotient >> (24 - 8*b));
+	}
+}
+
+bool shareTarget::isReachedBy(const uint8_t* hash) const 
+{
+	return reachable && (memcmp(hash, threshold, sizeof(threshold)) <= 0);
+}
+
+void shareTarget::thresholdWords(uint32_t* words) const 
+{
+	for (uint32_t i = 0; i < 8; i++) 
+	{
+		const uint8_t* limb = &threshold[4*i];
+		words[i] = reachable ? ((uint32_t) limb[0] << 24) | ((uint32_t) limb[1] << 16) | ((uint32_t) limb[2] << 8) | limb[3] : 0;
+	}
+}
+
+}
@@ -0,0 +1,38 @@
+// BEAM OpenCL Miner
+// Share target of a job as a 256 bit threshold
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_shareTarget_H 
+#define beamMiner_shareTarget_H 
+
+#include <cstdint>
+
+#include "core/difficulty.h"
+
+namespace beamMiner 
+{
+
+// Difficulty::IsTargetReached multiplies the hash with the difficulty D and accepts if 
+// the product is below 2^280. That is the same as hash <= (2^280 - 1) / D, so the quotient
+// is computed once per job and every solution only needs a compare of the big endian hash.
+class shareTarget 
+{
+	private:
+	uint8_t threshold[32];
+	bool reachable;
+
+	public:
+	shareTarget();
+	shareTarget(const beam::Difficulty&);
+
+	bool isReachedBy(const uint8_t* hash) const;
+
+	// The threshold as 8 big endian words for the filter kernel, all zero if no hash can reach it
+	void thresholdWords(uint32_t* words) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+// BEAM OpenCL Miner
+// Compressed form of Equihash 150/5 solutions as the pool expects it
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_solutionCodec_H 
+#define beamMiner_solutionCodec_H 
+
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Every index is written with collision bits + 1 bits, most significant bit first,
+// the indices directly behind each other. For 150/5 that are 32 indices of 26 bits in 104 bytes.
+template <uint32_t indexBits, uint32_t indexCount>
+struct solutionCodec 
+{
+	static_assert((indexBits * indexCount) % 32 == 0, "the packed solution has to fill whole 32 bit words");
+	static_assert(indexBits <= 32, "an index has to fit a 32 bit word");
+
+	static const uint32_t packedSize = indexBits * indexCount / 8;
+
+	// Indices are shifted into a 64 bit accumulator that is flushed 32 bits at a time
+	static void pack(const uint32_t* indices, uint8_t* out) 
+	{
+		const uint64_t mask = ((uint64_t) 1 << indexBits) - 1;
+
+		uint64_t acc = 0;
+		uint32_t accBits = 0;
+		for (uint32_t i = 0; i < indexCount; i++) 
+		{
+			acc = (acc << indexBits) | (indices[i] & mask);
+			accBits += indexBits;
+
+			if (accBits >= 32) 
+			{
+				accBits -= 32;
+				uint32_t word = (uint32_t) (acc >> accBits);
+				out[0] = (uint8_t) (word >> 24);
+				out[1] = (uint8_t) (word >> 16);
+				out[2] = (uint8_t) (word >> 8);
+				out[3] = (uint8_t) word;
+				out += 4;
+			}
+		}
+	}
+
+	static void unpack(const uint8_t* in, uint32_t* indices) 
+	{
+		const uint64_t mask = ((uint64_t) 1 << indexBits) - 1;
+
+		uint64_t acc = 0;
+		uint32_t accBits = 0;
+		for (uint32_t i = 0; i < indexCount; i++) 
+		{
+			if (accBits < indexBits) 
+			{
+				uint32_t word = ((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16) | ((uint32_t) in[2] << 8) | in[3];
+				acc = (acc << 32) | word;
+				accBits += 32;
+				in += 4;
+			}
+
+			accBits -= indexBits;
+			indices[i] = (uint32_t) ((acc >> accBits) & mask);
+		}
+	}
+};
+
+typedef solutionCodec<26, 32> beamSolutionCodec;
+
+}
+
+#endif
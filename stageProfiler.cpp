@@ -0,0 +1,61 @@
+// BEAM OpenCL Miner
+// Kernel stage timing statistics
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "stageProfiler.h"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+namespace beamMiner 
+{
+
+stageProfiler::stageProfiler(const std::vector<std::string>& stageNames) 
+{
+	for (const std::string& name : stageNames) 
+	{
+		std::vector<std::string>::iterator it = std::find(names.begin(), names.end(), name);
+		stageToName.push_back(std::distance(names.begin(), it));
+		if (it == names.end()) names.push_back(name);
+	}
+
+	samples.resize(names.size());
+}
+
+// Duration of one stage in nanoseconds as reported by the device
+void stageProfiler::add(size_t stage, uint64_t duration) 
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	samples[stageToName[stage]].push_back(duration * 1e-6);
+}
+
+std::string stageProfiler::report() 
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(2);
+
+	for (size_t i = 0; i < names.size(); i++) 
+	{
+		std::vector<double>& stage = samples[i];
+		if (stage.empty()) continue;
+
+		double sum = 0;
+		for (double sample : stage) sum += sample;
+
+		std::sort(stage.begin(), stage.end());
+		size_t p99 = (stage.size() * 99 + 99) / 100 - 1;
+
+		ss << names[i] << " " << sum / stage.size() << "/" << stage[p99] << " ";
+		stage.clear();
+	}
+
+	return ss.str();
+}
+
+}
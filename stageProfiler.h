@@ -0,0 +1,40 @@
+// BEAM OpenCL Miner
+// Kernel stage timing statistics
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_stageProfiler_H 
+#define beamMiner_stageProfiler_H 
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Collects the device durations of every kernel stage. Stages sharing a kernel 
+// name (the two halves of round0 / round1 on 3G) are reported together.
+class stageProfiler 
+{
+	private:
+	std::vector<std::string> names;
+	std::vector<size_t> stageToName;
+	std::vector< std::vector<double> > samples;
+
+	std::mutex lock;
+
+	public:
+	stageProfiler(const std::vector<std::string>&);
+
+	void add(size_t, uint64_t);
+
+	// Mean and p99 in milliseconds of all samples since the last report, then starts over
+	std::string report();
+};
+
+}
+
+#endif
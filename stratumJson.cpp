@@ -0,0 +1,190 @@
+// BEAM OpenCL Miner
+// In place parser for the stratum messages of the Beam pool protocol
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "stratumJson.h"
+
+#include <cstring>
+#include <climits>
+
+namespace beamMiner 
+{
+
+bool jsonValue::present() const 
+{
+	return (data != NULL);
+}
+
+bool jsonValue::equals(const char* text) const 
+{
+	return present() && (strlen(text) == size) && (memcmp(data, text, size) == 0);
+}
+
+bool jsonValue::toUint64(uint64_t& out) const 
+{
+	if (!present() || (size == 0) || (size > 20)) return false;
+
+	uint64_t value = 0;
+	for (size_t i = 0; i < size; i++) 
+	{
+		if ((data[i] < '0') || (data[i] > '9')) return false;
+
+		uint64_t next = value * 10 + (data[i] - '0');
+		if (next / 10 != value) return false;
+		value = next;
+	}
+
+	out = value;
+	return true;
+}
+
+bool jsonValue::toInt32(int32_t& out) const 
+{
+	if (!present() || (size == 0)) return false;
+
+	bool negative = (data[0] == '-');
+	jsonValue digits;
+	digits.data = data + (negative ? 1 : 0);
+	digits.size = size - (negative ? 1 : 0);
+
+	uint64_t value;
+	if (!digits.toUint64(value) || (value > (negative ? (uint64_t) INT32_MAX + 1 : (uint64_t) INT32_MAX))) return false;
+
+	out = negative ? (int32_t) (0 - value) : (int32_t) value;
+	return true;
+}
+
+static bool isSpace(char c) 
+{
+	return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static bool keyEquals(const char* key, size_t size, const char* name) 
+{
+	if (strlen(name) != size) return false;
+
+	for (size_t i = 0; i < size; i++) 
+	{
+		char c = key[i];
+		if ((c >= 'A') && (c <= 'Z')) c += 'a' - 'A';
+		if (c != name[i]) return false;
+	}
+	return true;
+}
+
+// Moves pos behind the string starting at pos, escapes are skipped but not decoded
+static bool skipString(const char* data, size_t size, size_t& pos) 
+{
+	for (pos++; pos < size; pos++) 
+	{
+		if (data[pos] == '\\') pos++;
+		else if (data[pos] == '"') 
+		{
+			pos++;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Moves pos behind the value starting at pos and returns its text in value
+static bool scanValue(const char* data, size_t size, size_t& pos, jsonValue& value) 
+{
+	size_t start = pos;
+
+	if (data[pos] == '"') 
+	{
+		if (!skipString(data, size, pos)) return false;
+
+		value.data = data + start + 1;
+		value.size = pos - start - 2;
+		return true;
+	}
+
+	if ((data[pos] == '{') || (data[pos] == '[')) 
+	{
+		uint32_t depth = 0;
+		while (pos < size) 
+		{
+			char c = data[pos];
+			if (c == '"') 
+			{
+				if (!skipString(data, size, pos)) return false;
+				continue;
+			}
+
+			if ((c == '{') || (c == '[')) depth++;
+			if ((c == '}') || (c == ']')) depth--;
+			pos++;
+
+			if (depth == 0) 
+			{
+				value.data = data + start;
+				value.size = pos - start;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Numbers, true, false and null end at the next separator
+	while ((pos < size) && (data[pos] != ',') && (data[pos] != '}') && !isSpace(data[pos])) pos++;
+	if (pos == start) return false;
+
+	value.data = data + start;
+	value.size = pos - start;
+	return true;
+}
+
+bool parseStratumMessage(const char* data, size_t size, stratumMessage& message) 
+{
+	message = stratumMessage();
+
+	size_t pos = 0;
+	while ((pos < size) && isSpace(data[pos])) pos++;
+	if ((pos == size) || (data[pos] != '{')) return false;
+	pos++;
+
+	while (true) 
+	{
+		while ((pos < size) && isSpace(data[pos])) pos++;
+		if (pos == size) return false;
+		if (data[pos] == '}') return true;
+		if (data[pos] != '"') return false;
+
+		size_t keyStart = pos + 1;
+		if (!skipString(data, size, pos)) return false;
+		size_t keySize = pos - keyStart - 1;
+
+		while ((pos < size) && isSpace(data[pos])) pos++;
+		if ((pos == size) || (data[pos] != ':')) return false;
+		pos++;
+		while ((pos < size) && isSpace(data[pos])) pos++;
+		if (pos == size) return false;
+
+		jsonValue value;
+		if (!scanValue(data, size, pos, value)) return false;
+
+		const char* key = data + keyStart;
+		if (keyEquals(key, keySize, "method")) message.method = value;
+		else if (keyEquals(key, keySize, "id")) message.id = value;
+		else if (keyEquals(key, keySize, "code")) message.code = value;
+		else if (keyEquals(key, keySize, "input")) message.input = value;
+		else if (keyEquals(key, keySize, "difficulty")) message.difficulty = value;
+		else if (keyEquals(key, keySize, "nonceprefix")) message.nonceprefix = value;
+
+		while ((pos < size) && isSpace(data[pos])) pos++;
+		if (pos == size) return false;
+		if (data[pos] == ',') 
+		{
+			pos++;
+			continue;
+		}
+		if (data[pos] == '}') return true;
+		return false;
+	}
+}
+
+}
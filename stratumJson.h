@@ -0,0 +1,46 @@
+// BEAM OpenCL Miner
+// In place parser for the stratum messages of the Beam pool protocol
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_stratumJson_H 
+#define beamMiner_stratumJson_H 
+
+#include <cstddef>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// Text of one value inside the receive buffer, strings without their quotes
+struct jsonValue 
+{
+	const char* data = NULL;
+	size_t size = 0;
+
+	bool present() const;
+	bool equals(const char*) const;
+	bool toUint64(uint64_t&) const;
+	bool toInt32(int32_t&) const;
+};
+
+// The members of job, cancel, result and login messages the miner reads
+struct stratumMessage 
+{
+	jsonValue method;
+	jsonValue id;
+	jsonValue code;
+	jsonValue input;
+	jsonValue difficulty;
+	jsonValue nonceprefix;
+};
+
+// Scans one line holding a JSON object without copying it. Keys are matched case 
+// insensitive, unknown members and nested values are skipped. False if the line is 
+// no well formed object.
+bool parseStratumMessage(const char*, size_t, stratumMessage&);
+
+}
+
+#endif
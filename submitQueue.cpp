@@ -0,0 +1,100 @@
+// BEAM OpenCL Miner
+// Bounded queue of solutions waiting for the stratum thread
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "submitQueue.h"
+
+#include <cstring>
+
+namespace beamMiner 
+{
+
+submitQueue::submitQueue() 
+{
+	slots.reset(new slot[capacity]);
+	for (uint32_t i = 0; i < capacity; i++) slots[i].sequence = i;
+
+	tail = 0;
+	head = 0;
+	dropped = 0;
+	peak = 0;
+}
+
+// A slot is free for position pos once its sequence reached pos
+bool submitQueue::push(int64_t workId, uint64_t nonce, const uint8_t* solution, uint32_t solutionSize) 
+{
+	if (solutionSize > submitRequest::maxSolutionSize) 
+	{
+		dropped++;
+		return false;
+	}
+
+	uint64_t pos = tail.load(std::memory_order_relaxed);
+	slot* target;
+	while (true) 
+	{
+		target = &slots[pos % capacity];
+		uint64_t sequence = target->sequence.load(std::memory_order_acquire);
+
+		if (sequence == pos) 
+		{
+			if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		}
+		else if (sequence < pos) 
+		{
+			// The consumer did not free this slot yet
+			dropped++;
+			return false;
+		}
+		else 
+		{
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	target->request.workId = workId;
+	target->request.nonce = nonce;
+	target->request.solutionSize = solutionSize;
+	memcpy(target->request.solution, solution, solutionSize);
+	target->sequence.store(pos + 1, std::memory_order_release);
+
+	uint32_t depth = pos + 1 - head.load(std::memory_order_relaxed);
+	uint32_t seen = peak.load(std::memory_order_relaxed);
+	while ((depth > seen) && !peak.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {}
+
+	return true;
+}
+
+// A slot is filled for position pos once its sequence reached pos + 1
+bool submitQueue::pop(submitRequest& request) 
+{
+	uint64_t pos = head.load(std::memory_order_relaxed);
+	slot* source = &slots[pos % capacity];
+
+	if (source->sequence.load(std::memory_order_acquire) != pos + 1) return false;
+
+	request = source->request;
+	source->sequence.store(pos + capacity, std::memory_order_release);
+	head.store(pos + 1, std::memory_order_relaxed);
+
+	return true;
+}
+
+uint64_t submitQueue::droppedCount() 
+{
+	return dropped;
+}
+
+uint32_t submitQueue::peakDepth() 
+{
+	return peak;
+}
+
+uint32_t submitQueue::getCapacity() 
+{
+	return capacity;
+}
+
+}
@@ -0,0 +1,63 @@
+// BEAM OpenCL Miner
+// Bounded queue of solutions waiting for the stratum thread
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_submitQueue_H 
+#define beamMiner_submitQueue_H 
+
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+namespace beamMiner 
+{
+
+// A solution that met the share target, the compressed 150/5 solution has 104 bytes
+struct submitRequest 
+{
+	static const uint32_t maxSolutionSize = 104;
+
+	int64_t workId;
+	uint64_t nonce;
+	uint32_t solutionSize;
+	uint8_t solution[maxSolutionSize];
+};
+
+// Ring of preallocated requests, any thread may push and only the stratum thread pops.
+// Every slot carries a sequence number that tells producers and the consumer whose
+// turn it is, so neither side takes a lock. A full queue drops the new solution.
+class submitQueue 
+{
+	private:
+	static const uint32_t capacity = 64;
+
+	struct slot 
+	{
+		std::atomic<uint64_t> sequence;
+		submitRequest request;
+	};
+
+	std::unique_ptr<slot[]> slots;
+	std::atomic<uint64_t> tail;
+	std::atomic<uint64_t> head;
+
+	// Backpressure accounting
+	std::atomic<uint64_t> dropped;
+	std::atomic<uint32_t> peak;
+
+	public:
+	submitQueue();
+
+	bool push(int64_t, uint64_t, const uint8_t*, uint32_t);
+	bool pop(submitRequest&);
+
+	uint64_t droppedCount();
+	uint32_t peakDepth();
+	uint32_t getCapacity();
+};
+
+}
+
+#endif
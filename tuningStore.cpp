@@ -0,0 +1,111 @@
+// BEAM OpenCL Miner
+// Persisted per device tuning profiles
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#include "tuningStore.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+namespace beamMiner 
+{
+
+std::mutex tuningStore::lock;
+
+// Tabs and line breaks separate the fields of the file, OpenCL strings may carry their terminating zero
+static std::string clean(const std::string& text) 
+{
+	std::string result = text.c_str();
+	for (char& c : result) 
+	{
+		if ((c == '\t') || (c == '\n') || (c == '\r')) c = ' ';
+	}
+
+	return result;
+}
+
+tuningStore::tuningStore(std::string fileNameIn) 
+{
+	fileName = fileNameIn;
+}
+
+std::string tuningStore::createKey(const std::string& name, const std::string& driver, uint64_t memory) 
+{
+	std::stringstream ss;
+	ss << clean(name) << "|" << clean(driver) << "|" << memory;
+
+	return ss.str();
+}
+
+// Line format: key, pipeline, group size, scratch size, bucket size, queue depth, intensity
+std::map<std::string, tuningProfile> tuningStore::readFile() 
+{
+	std::map<std::string, tuningProfile> profiles;
+
+	std::ifstream file(fileName);
+	std::string line;
+	while (std::getline(file, line)) 
+	{
+		std::stringstream ss(line);
+		std::string key, values;
+		if (!std::getline(ss, key, '\t') || !std::getline(ss, values)) continue;
+
+		tuningProfile profile;
+		std::stringstream vs(values);
+		if (vs >> profile.pipeline >> profile.tuning.groupSize >> profile.tuning.scratchSize >> profile.tuning.bucketSize >> profile.queueDepth >> profile.intensity) 
+		{
+			profiles[key] = profile;
+		}
+	}
+
+	return profiles;
+}
+
+bool tuningStore::load(const std::string& key, tuningProfile& profile) 
+{
+	if (fileName.empty()) return false;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	std::map<std::string, tuningProfile> profiles = readFile();
+	std::map<std::string, tuningProfile>::iterator it = profiles.find(key);
+	if (it == profiles.end()) return false;
+
+	profile = it->second;
+
+	return true;
+}
+
+void tuningStore::store(const std::string& key, const tuningProfile& profile) 
+{
+	if (fileName.empty()) return;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	std::map<std::string, tuningProfile> profiles = readFile();
+	profiles[key] = profile;
+
+	// Replace the file as a whole, an aborted write never destroys the old profiles
+	std::string temporary = fileName + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::trunc);
+		if (!file) return;
+
+		for (const std::pair<const std::string, tuningProfile>& entry : profiles) 
+		{
+			const tuningProfile& p = entry.second;
+			file << entry.first << "\t" << p.pipeline << " " << p.tuning.groupSize << " " << p.tuning.scratchSize << " " 
+				<< p.tuning.bucketSize << " " << p.queueDepth << " " << p.intensity << "\n";
+		}
+
+		if (!file) return;
+	}
+
+	std::remove(fileName.c_str());
+	std::rename(temporary.c_str(), fileName.c_str());
+}
+
+}
@@ -0,0 +1,52 @@
+// BEAM OpenCL Miner
+// Persisted per device tuning profiles
+// Copyright 2018 The Beam Team	
+// Copyright 2018 Wilke Trei
+// Copyright 2019 Andrei Dimitrief-Jianu
+
+#ifndef beamMiner_tuningStore_H 
+#define beamMiner_tuningStore_H 
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+#include "clPipeline.h"
+
+namespace beamMiner 
+{
+
+// Settings found by the auto tuner for one kind of device
+struct tuningProfile 
+{
+	std::string pipeline;
+	clTuning tuning;
+	uint32_t queueDepth;
+	uint32_t intensity;
+};
+
+// Text file with one profile per line. Devices are told apart by name, driver version 
+// and memory size, so a driver update or a different card triggers a new tuning run.
+class tuningStore 
+{
+	private:
+	std::string fileName;
+
+	// Shared by all stores, each host and device worker may write the same file
+	static std::mutex lock;
+
+	std::map<std::string, tuningProfile> readFile();
+
+	public:
+	tuningStore(std::string);
+
+	static std::string createKey(const std::string&, const std::string&, uint64_t);
+
+	bool load(const std::string&, tuningProfile&);
+	void store(const std::string&, const tuningProfile&);
+};
+
+}
+
+#endif